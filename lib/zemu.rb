@@ -1,11 +1,17 @@
 require 'erb'
 
 require 'pty'
+require 'digest'
+require 'fileutils'
 
 require_relative 'zemu/config'
 require_relative 'zemu/instance'
 require_relative 'zemu/interactive'
 require_relative 'zemu/debug'
+require_relative 'zemu/frame'
+require_relative 'zemu/pool'
+require_relative 'zemu/blocks'
+require_relative 'zemu/heatmap'
 
 # Zemu is a module providing an interface to build and interact with
 # configurable Z80 emulators.
@@ -82,34 +88,164 @@ module Zemu
 
     # Builds a library according to the given configuration.
     #
+    # Builds are safe to run concurrently: the library is written to a temporary file
+    # and then renamed into place, and a lock file in the output directory ensures that
+    # only one process builds a given configuration at a time. A process which has
+    # waited for another to build the same configuration does not build it again.
+    #
     # @param [Zemu::Config] configuration The configuration for which an emulator will be generated.
+    # @param pgo A workload with which to perform a profile-guided optimisation of the library, or nil
+    #            for a normal build. See Zemu::build_profile_guided.
+    # @param pgo_key A key identifying the workload, which must change whenever the workload does.
+    #                See Zemu::build_profile_guided.
     #
     # @returns true if the build is a success, false (build failed) or nil (compiler not found) otherwise.
-    def Zemu::build(configuration)
+    #
+    # @raise [ArgumentError] Raised if a workload is given, but the compiler is not clang.
+    def Zemu::build(configuration, pgo: nil, pgo_key: nil)
+        profdata_tool(configuration) unless pgo.nil?
+
         # Create the output directory unless it already exists.
-        unless Dir.exist? configuration.output_directory
-            Dir.mkdir configuration.output_directory
-        end
+        FileUtils.mkdir_p configuration.output_directory
+
+        lock = File.join(configuration.output_directory, "#{configuration.name}.lock")
+
+        File.open(lock, File::RDWR | File::CREAT) do |f|
+            f.flock(File::LOCK_EX)
+
+            # Generate the autogenerated source files.
+            generate(configuration)
+
+            # Find the blocks of code in ROM, unless they are already known.
+            if configuration.batch_blocks && !blocks_current?(configuration)
+                result = find_blocks(configuration)
+                return result unless result
+            end
+
+            # Skip the build if the library is already up-to-date.
+            workload_key = pgo.nil? ? nil : Zemu::workload_key(pgo, pgo_key)
+            digest = build_digest(configuration, workload_key)
+            digest_path = configuration.library + ".digest"
+
+            up_to_date = File.exist?(configuration.library) && File.exist?(digest_path) && File.read(digest_path) == digest
+            up_to_date &&= File.exist?(configuration.archive) if configuration.build_static
+
+            return true if up_to_date
 
-        # Generate the autogenerated source files.
-        generate(configuration)
+            result = if pgo.nil?
+                compile(configuration, configuration.library)
+            else
+                build_profile_guided(configuration, pgo, workload_key)
+            end
 
-        output = File.join(configuration.output_directory, "#{configuration.name}.so")
+            write_atomic(digest_path, digest) if result
 
+            return result
+        end
+    end
+
+    # Returns a digest of the inputs to a build of the given configuration, optimised with
+    # the profile of the workload with the given key, or nil for a normal build.
+    # The sources must already have been generated.
+    def Zemu::build_digest(configuration, pgo)
         autogen = File.join(configuration.output_directory, "autogen_#{configuration.name}")
 
+        digest = Digest::SHA256.new
+        digest << configuration.compiler
+        digest << configuration.compiler_flags.join(" ")
+        digest << (pgo.nil? ? "" : "pgo:#{pgo}")
+        digest << (configuration.build_static ? "static" : "")
+
+        sources = Dir.glob(File.join(autogen, "*")).sort
+        sources += Dir.glob(File.join(SRC, "**", "*.{c,h}")).sort
+
+        sources.each { |f| digest << File.read(f) }
+
+        return digest.hexdigest
+    end
+
+    # Compiles the sources for a given configuration into a library.
+    #
+    # The sources must already have been generated. Each source file is compiled to an object
+    # file separately, using up to +build_jobs+ compiler processes in parallel, and the objects
+    # are then linked into a temporary file which is renamed to the output path.
+    #
+    # @param [Zemu::Config] configuration The configuration for which an emulator will be compiled.
+    # @param [String] output The path of the library to be compiled.
+    # @param [Array<String>] flags Compiler flags in addition to those given by the configuration.
+    #
+    # @returns true if the build is a success, false (build failed) or nil (compiler not found) otherwise.
+    def Zemu::compile(configuration, output, flags=[])
+        objects_dir = File.join(File.dirname(output), "obj_#{File.basename(output, ".so")}")
+
+        objects = compile_objects(configuration, sources(configuration), objects_dir, flags)
+        return objects unless objects.is_a?(Array)
+
         compiler = configuration.compiler
 
+        flags_str = (configuration.compiler_flags + flags).join(" ")
+
+        # Link the objects into a temporary library, and move it into place.
+        temp = "#{output}.#{Process.pid}.tmp"
+
+        result = system("#{compiler} #{flags_str} -fPIC -pthread -shared -Wl,-undefined -Wl,dynamic_lookup -o #{temp} #{objects.join(" ")}")
+
+        if result
+            File.rename(temp, output)
+        else
+            FileUtils.rm_f temp
+        end
+
+        # Archive the same objects for hosts which link the emulator statically.
+        if result && configuration.build_static && output == configuration.library
+            temp = "#{configuration.archive}.#{Process.pid}.tmp"
+
+            result = system("#{configuration.archiver} rcs #{temp} #{objects.join(" ")}")
+
+            if result
+                File.rename(temp, configuration.archive)
+            else
+                FileUtils.rm_f temp
+            end
+        end
+
+        return result
+    end
+
+    # Returns the paths of the source files of the library for a given configuration.
+    def Zemu::sources(configuration)
+        autogen = File.join(configuration.output_directory, "autogen_#{configuration.name}")
+
         inputs = [
             "main.c",                       # main library functionality
             "debug.c",                      # debug functionality
+            "condition.c",                  # conditional breakpoints
             "interrupt.c",                  # interrupt functionality
+            "disassemble.c",                # disassembler
+            "gdb.c",                        # GDB remote serial protocol server
+            "async.c",                      # background execution
+            "link.c",                       # serial links between machines
+            "fuzz.c",                       # fuzzing with edge coverage
             "external/z80/sources/Z80.c"    # z80 core library
         ]
 
-        inputs_str = inputs.map { |i| File.join(SRC, i) }.join(" ")
+        inputs = inputs.map { |i| File.join(SRC, i) }
 
-        inputs_str += " " + File.join(autogen, "memory.c") + " " + File.join(autogen, "io.c")
+        inputs += %w(memory.c io.c cpu.c blocks.c).map { |i| File.join(autogen, i) }
+
+        return inputs
+    end
+
+    # Compiles each of the given source files to an object file in the given directory,
+    # using up to +build_jobs+ compiler processes in parallel.
+    #
+    # @returns the paths of the object files if all compile, false (compilation failed) or nil (compiler not found) otherwise.
+    def Zemu::compile_objects(configuration, inputs, objects_dir, flags=[])
+        autogen = File.join(configuration.output_directory, "autogen_#{configuration.name}")
+
+        FileUtils.mkdir_p objects_dir
+
+        compiler = configuration.compiler
 
         defines = {
             "CPU_Z80_STATIC" => 1,
@@ -129,10 +265,285 @@ module Zemu
 
         includes_str += " -I" + autogen
 
-        command = "#{compiler} -O2 -Werror -Wno-unknown-warning-option -fPIC -shared -Wl,-undefined -Wl,dynamic_lookup #{includes_str} #{defines_str} -o #{output} #{inputs_str}"
-        
-        # Run the compiler and generate a library.
-        return system(command)
+        flags_str = (configuration.compiler_flags + flags).join(" ")
+
+        objects = inputs.map { |i| File.join(objects_dir, File.basename(i, ".c") + ".o") }
+
+        # Compile each source file in parallel.
+        queue = Queue.new
+        inputs.zip(objects).each { |job| queue << job }
+        queue.close
+
+        results = Array.new([configuration.build_jobs, inputs.size].min) do
+            Thread.new do
+                thread_results = []
+
+                while (job = queue.pop)
+                    input, object = job
+                    thread_results << system("#{compiler} #{flags_str} -Werror -Wno-unknown-warning-option -fPIC -pthread -c #{includes_str} #{defines_str} -o #{object} #{input}")
+                end
+
+                thread_results
+            end
+        end.flat_map(&:value)
+
+        return nil if results.include? nil
+        return false if results.include? false
+
+        return objects
+    end
+
+    # Builds a libFuzzer target for the given configuration, which fuzzes the
+    # emulated program through one of its serial ports. See src/fuzz_main.c.
+    #
+    # The machine boots once, from reset until +entry+ is reached, or for +boot_cycles+ cycles
+    # if no entry address is given. Each input is then run from a snapshot of the booted machine,
+    # fed to the serial port, and coverage of the edges between emulated instructions is given
+    # to libFuzzer. Reaching any address in +crash+ is reported as a crash.
+    #
+    # The target is built with clang, which must be the configured compiler, and is cached
+    # like the library until its sources or parameters change.
+    #
+    # @param [Zemu::Config] configuration The configuration for which a fuzzer will be built.
+    # @param serial The name of the serial port to which inputs are fed.
+    # @param cycles The maximum number of cycles for which each input runs.
+    # @param boot_cycles The number of cycles for which the machine boots, or the maximum if +entry+ is given
+    #                    (0 for no maximum).
+    # @param entry The address at which the machine has finished booting, or nil.
+    # @param crash Addresses which are reported as a crash when reached, such as the address of a fault handler.
+    #
+    # @example
+    #
+    #   # Fuzz the command parser, which is waiting for input once 0x0150 is reached.
+    #   Zemu.build_fuzzer(conf, serial: "serial", entry: 0x0150, crash: [0x0038])
+    #
+    #   # Run the fuzzer from the shell:
+    #   #   bin/zemu_emulator_release_fuzz corpus/
+    #
+    # @raise [ArgumentError] Raised if there is no serial port with the given name.
+    #
+    # @returns true if the build is a success, false (build failed) or nil (compiler not found) otherwise.
+    def Zemu::build_fuzzer(configuration, serial:, cycles: 1_000_000, boot_cycles: 0, entry: nil, crash: [])
+        unless configuration.io.any? { |d| d.is_a?(Config::SerialPort) && d.name.to_s == serial.to_s }
+            raise ArgumentError, "No serial port named #{serial}."
+        end
+
+        defines = {
+            "ZEMU_FUZZ_LIBFUZZER" => 1,
+            "ZEMU_FUZZ_SERIAL" => serial,
+            "ZEMU_FUZZ_CYCLES" => cycles.to_i,
+            "ZEMU_FUZZ_BOOT_CYCLES" => boot_cycles.to_i,
+            "ZEMU_FUZZ_ENTRY" => entry.nil? ? -1 : entry.to_i,
+            "ZEMU_FUZZ_CRASH" => crash.map { |a| "0x%04x," % a }.join
+        }
+
+        flags = defines.map { |d, v| "-D#{d}=#{v}" }
+
+        FileUtils.mkdir_p configuration.output_directory
+
+        lock = File.join(configuration.output_directory, "#{configuration.name}.lock")
+
+        File.open(lock, File::RDWR | File::CREAT) do |f|
+            f.flock(File::LOCK_EX)
+
+            generate(configuration)
+
+            output = configuration.fuzzer
+            digest = Digest::SHA256.hexdigest(build_digest(configuration, nil) + flags.join(" "))
+            digest_path = output + ".digest"
+
+            return true if File.exist?(output) && File.exist?(digest_path) && File.read(digest_path) == digest
+
+            objects_dir = File.join(configuration.output_directory, "obj_#{File.basename(output)}")
+
+            objects = compile_objects(configuration, sources(configuration) + [File.join(SRC, "fuzz_main.c")], objects_dir, flags)
+            return objects unless objects.is_a?(Array)
+
+            temp = "#{output}.#{Process.pid}.tmp"
+
+            result = system("#{configuration.compiler} #{configuration.compiler_flags.join(" ")} -fsanitize=fuzzer -pthread -o #{temp} #{objects.join(" ")}")
+
+            if result
+                File.rename(temp, output)
+                write_atomic(digest_path, digest)
+            else
+                FileUtils.rm_f temp
+            end
+
+            return result
+        end
+    end
+
+    # Builds a library for the given configuration, optimised using a profile
+    # gathered by running a workload on an instrumented build of the same library.
+    #
+    # The profile is cached in the output directory, and is reused by subsequent builds
+    # until the generated sources (including the contents of memory), the compiler flags
+    # or the key of the workload change. A number of cycles is its own key. A callable
+    # workload cannot be compared, so it has the key given by the caller, or an empty key:
+    # pass a new +pgo_key+ to Zemu::build whenever such a workload changes.
+    # Profile-guided optimisation is only supported with clang; the llvm-profdata tool corresponding
+    # to the configured compiler must be available.
+    #
+    # @param [Zemu::Config] configuration The configuration for which an emulator will be generated.
+    # @param workload Either the number of cycles for which the instrumented emulator should run,
+    #                 or a callable object which is given the instrumented Zemu::Instance to run.
+    # @param key The key of the workload. See Zemu::workload_key.
+    #
+    # @example
+    #
+    #   # Profile the emulator while running the firmware for 10 million cycles.
+    #   Zemu.build(conf, pgo: 10_000_000)
+    #
+    #   # Profile the emulator while running the firmware until it halts.
+    #   Zemu.build(conf, pgo: ->(instance) { instance.continue }, pgo_key: "until-halt")
+    #
+    # @returns true if the build is a success, false (build failed) or nil (compiler not found) otherwise.
+    #
+    # @raise [ArgumentError] Raised if the compiler is not clang.
+    def Zemu::build_profile_guided(configuration, workload, key=workload_key(workload))
+        profdata = profdata_tool(configuration)
+
+        profile_dir = File.join(configuration.output_directory, "pgo_#{configuration.name}_#{configuration.build_profile}")
+        profile = File.join(profile_dir, "#{configuration.name}.profdata")
+        digest_path = File.join(profile_dir, "#{configuration.name}.digest")
+
+        digest = build_digest(configuration, key)
+
+        cached = File.exist?(profile) && File.exist?(digest_path) && File.read(digest_path) == digest
+
+        unless cached
+            FileUtils.rm_rf profile_dir
+            FileUtils.mkdir_p profile_dir
+
+            # Build an instrumented library.
+            instrumented = File.join(profile_dir, "#{configuration.name}_instrumented.so")
+            result = compile(configuration, instrumented, ["-fprofile-instr-generate"])
+            return result unless result
+
+            # Run the workload in a child process, so that the profile is written
+            # when the instrumented library is unloaded at exit.
+            pid = fork do
+                ENV["LLVM_PROFILE_FILE"] = File.join(profile_dir, "#{configuration.name}-%p.profraw")
+
+                instance = Instance.new(configuration, instrumented)
+
+                if workload.respond_to? :call
+                    workload.call(instance)
+                else
+                    instance.continue(workload.to_i)
+                end
+
+                instance.quit
+
+                exit 0
+            end
+
+            Process.wait(pid)
+            return false unless $?.success?
+
+            # Merge the raw profiles.
+            raw = Dir.glob(File.join(profile_dir, "*.profraw")).join(" ")
+            result = system("#{profdata} merge -output=#{profile} #{raw}")
+            return result unless result
+
+            write_atomic(digest_path, digest)
+        end
+
+        return compile(configuration, configuration.library,
+                       ["-fprofile-instr-use=#{profile}", "-Wno-profile-instr-unprofiled", "-Wno-profile-instr-out-of-date"])
+    end
+
+    # Returns the path of the llvm-profdata tool corresponding to the compiler of a configuration,
+    # such as llvm-profdata-17 for clang-17.
+    #
+    # @raise [ArgumentError] Raised if the compiler is not clang.
+    def Zemu::profdata_tool(configuration)
+        unless File.basename(configuration.compiler) =~ /\Aclang/
+            raise ArgumentError, "Profile-guided optimisation requires the clang compiler, not #{configuration.compiler}."
+        end
+
+        return configuration.compiler.sub(/clang(?=[^\/]*\z)/, "llvm-profdata")
+    end
+
+    # Returns the key identifying a profiling workload: the given key if there is one,
+    # the number of cycles for a numeric workload, or an empty key for a callable workload.
+    def Zemu::workload_key(workload, key=nil)
+        return key.to_s unless key.nil?
+        return workload.respond_to?(:call) ? "" : workload.to_i.to_s
+    end
+
+    # Finds the blocks of code in the read-only memory of a configuration, by building a library
+    # without them and disassembling its memory in a child process. The blocks are saved in the
+    # autogen directory, and the sources are generated again to include them. See Zemu::Blocks.
+    #
+    # @returns true if the analysis is a success, false (build failed) or nil (compiler not found) otherwise.
+    def Zemu::find_blocks(configuration)
+        analysis_dir = File.join(configuration.output_directory, "blocks_#{configuration.name}_#{configuration.build_profile}")
+        FileUtils.mkdir_p analysis_dir
+
+        analysis = File.join(analysis_dir, "#{configuration.name}.so")
+
+        result = compile(configuration, analysis)
+        return result unless result
+
+        reader, writer = IO.pipe
+
+        pid = fork do
+            reader.close
+
+            instance = Instance.new(configuration, analysis)
+            writer.write(Marshal.dump(Blocks.analyse(configuration, instance)))
+            instance.quit
+
+            exit! 0
+        end
+
+        writer.close
+        data = reader.read
+        reader.close
+
+        Process.wait(pid)
+        return false unless $?.success?
+
+        blocks = Marshal.load(data)
+
+        autogen = File.join(configuration.output_directory, "autogen_#{configuration.name}")
+        write_atomic(File.join(autogen, "blocks.dat"), Marshal.dump([blocks_key(configuration), blocks]))
+
+        generate_blocks(configuration)
+
+        return true
+    end
+
+    # Returns a digest of the inputs to the analysis of the blocks of code in ROM:
+    # the generated memory, the entry points and the disassembler.
+    def Zemu::blocks_key(configuration)
+        autogen = File.join(configuration.output_directory, "autogen_#{configuration.name}")
+
+        digest = Digest::SHA256.new
+        digest << File.read(File.join(autogen, "memory.c"))
+        digest << configuration.entry_points.join(",")
+        digest << File.read(File.join(SRC, "disassemble.c"))
+
+        return digest.hexdigest
+    end
+
+    # Returns the saved blocks of code in ROM for a configuration with the +batch_blocks+
+    # parameter set, or nil if there are none or they are out of date.
+    def Zemu::saved_blocks(configuration)
+        return nil unless configuration.batch_blocks
+
+        path = File.join(configuration.output_directory, "autogen_#{configuration.name}", "blocks.dat")
+        return nil unless File.exist?(path)
+
+        key, blocks = Marshal.load(File.binread(path))
+        return (key == blocks_key(configuration)) ? blocks : nil
+    end
+
+    # Returns true if the saved blocks of code in ROM of a configuration are up-to-date.
+    def Zemu::blocks_current?(configuration)
+        return !saved_blocks(configuration).nil?
     end
 
     # Generates the prerequisite source and header files for a given configuration.
@@ -141,6 +552,8 @@ module Zemu
     def Zemu::generate(configuration)
         generate_memory(configuration)
         generate_io(configuration)
+        generate_cpu(configuration)
+        generate_blocks(configuration)
     end
 
     # Generates the memory.c and memory.h files for a given configuration.
@@ -150,15 +563,13 @@ module Zemu
 
         autogen = File.join(configuration.output_directory, "autogen_#{configuration.name}")
 
-        unless Dir.exist? autogen
-            Dir.mkdir autogen
-        end
+        FileUtils.mkdir_p autogen
 
-        File.write(File.join(autogen, "memory.h"),
-                   header_template.result(configuration.get_binding))
+        write_atomic(File.join(autogen, "memory.h"),
+                     header_template.result(configuration.get_binding))
 
-        File.write(File.join(autogen, "memory.c"),
-                   source_template.result(configuration.get_binding))
+        write_atomic(File.join(autogen, "memory.c"),
+                     source_template.result(configuration.get_binding))
     end
 
     # Generates the io.c and io.h files for a given configuration.
@@ -168,14 +579,53 @@ module Zemu
 
         autogen = File.join(configuration.output_directory, "autogen_#{configuration.name}")
 
-        unless Dir.exist? autogen
-            Dir.mkdir autogen
-        end
+        FileUtils.mkdir_p autogen
+
+        write_atomic(File.join(autogen, "io.h"),
+                     header_template.result(configuration.get_binding))
+
+        write_atomic(File.join(autogen, "io.c"),
+                     source_template.result(configuration.get_binding))
+    end
+
+    # Generates the cpu.c and cpu.h files for a given configuration.
+    def Zemu::generate_cpu(configuration)
+        header_template = ERB.new File.read(File.join(SRC, "cpu.h.erb"))
+        source_template = ERB.new File.read(File.join(SRC, "cpu.c.erb"))
+
+        autogen = File.join(configuration.output_directory, "autogen_#{configuration.name}")
+
+        FileUtils.mkdir_p autogen
+
+        write_atomic(File.join(autogen, "cpu.h"),
+                     header_template.result(configuration.get_binding))
+
+        write_atomic(File.join(autogen, "cpu.c"),
+                     source_template.result(configuration.get_binding))
+    end
+
+    # Generates the blocks.c file for a given configuration, from its saved blocks of code in ROM, if any.
+    def Zemu::generate_blocks(configuration)
+        source_template = ERB.new File.read(File.join(SRC, "blocks.c.erb"))
+
+        autogen = File.join(configuration.output_directory, "autogen_#{configuration.name}")
+
+        FileUtils.mkdir_p autogen
+
+        blocks = saved_blocks(configuration) || {}
+        pages = blocks.sort.group_by { |address, _| address >> 8 }
+
+        write_atomic(File.join(autogen, "blocks.c"),
+                     source_template.result_with_hash(pages: pages))
+    end
 
-        File.write(File.join(autogen, "io.h"),
-                   header_template.result(configuration.get_binding))
+    # Writes the given contents to a file, by writing a temporary file and
+    # renaming it into place. The file is left untouched if its contents are unchanged.
+    def Zemu::write_atomic(path, contents)
+        return if File.exist?(path) && File.read(path) == contents
 
-        File.write(File.join(autogen, "io.c"),
-                   source_template.result(configuration.get_binding))
+        temp = "#{path}.#{Process.pid}.tmp"
+        File.write(temp, contents)
+        File.rename(temp, path)
     end
-end
\ No newline at end of file
+end
@@ -0,0 +1,106 @@
+module Zemu
+    # Finds the blocks of instructions in the read-only memory of a configuration,
+    # for a library built with the +batch_blocks+ parameter set.
+    #
+    # Code is found by following the control flow of the program from the reset
+    # and interrupt vectors, and from the +entry_points+ of the configuration.
+    # Each block runs from an instruction to the first instruction after it which may
+    # branch, halt, repeat or write to an IO device, or which is the last in read-only memory.
+    #
+    # This batches the run loop; it does not compile code. The instructions of a block
+    # are still executed by the CPU core's interpreter, but with a single call into it,
+    # rather than checking for breakpoints and other stop conditions after each instruction.
+    # Blocks only run when there is nothing to check after each instruction, and when
+    # every IO device clocked by the primary CPU can say that it will not interrupt
+    # during the block (see IOPort#when_quiet). Otherwise, and for code in RAM and code
+    # not reached by the analysis, instructions run one at a time.
+    module Blocks
+        # Reset and interrupt vectors of the Z80: RST 0x00 to 0x38 and the NMI.
+        VECTORS = [0x00, 0x08, 0x10, 0x18, 0x20, 0x28, 0x30, 0x38, 0x66]
+
+        # Maximum number of instructions in a block.
+        MAX_INSTRUCTIONS = 255
+
+        # Maximum number of T-states taken by all but the last instruction of a block:
+        # ZEMU_DEBUG_QUANTUM, so that pacing, serial bridging, stop requests and the watchdog
+        # are checked about as often as when running an instruction at a time.
+        MAX_CYCLES = 1000
+
+        # Mnemonics of instructions which write to an IO device, and so may change when it next interrupts.
+        OUTPUTS = %w(OUT OUTI OUTD OTIR OTDR)
+
+        # Returns the blocks of the given configuration, as a hash from the address
+        # of the first instruction of each block to its number of instructions and
+        # the T-states taken by all but its last instruction.
+        #
+        # @param [Zemu::Config] configuration The configuration of the instance.
+        # @param [Zemu::Instance] instance An instance from which instructions are disassembled.
+        def self.analyse(configuration, instance)
+            rom = readonly(configuration)
+
+            # Instructions reachable from the vectors and entry points.
+            found = {}
+            pending = VECTORS + configuration.entry_points
+
+            until pending.empty?
+                address = pending.pop
+
+                loop do
+                    break if found.key?(address)
+
+                    instruction = instance.disassemble(address).first
+                    break unless (0...instruction.length).all? { |i| rom[(address + i) & 0xffff] }
+
+                    found[address] = instruction
+
+                    pending << instruction.target unless instruction.target.nil?
+
+                    # An unconditional branch, return or halt does not continue to the next instruction.
+                    break if instruction.halt?
+                    break if (instruction.branch? || instruction.return?) && !instruction.conditional? &&
+                             !instruction.call? && !instruction.loop? && !instruction.repeat?
+
+                    address = (address + instruction.length) & 0xffff
+                end
+            end
+
+            # Each instruction found starts a block, running to the end of its straight-line code.
+            blocks = {}
+
+            found.keys.sort.reverse_each do |address|
+                instruction = found[address]
+                following = blocks[(address + instruction.length) & 0xffff]
+
+                last = instruction.branch? || instruction.return? || instruction.repeat? ||
+                       instruction.halt? || OUTPUTS.include?(instruction.mnemonic) || following.nil?
+
+                blocks[address] = if last
+                    [1, 0]
+                elsif following[0] >= MAX_INSTRUCTIONS || following[1] + instruction.cycles > MAX_CYCLES
+                    [1, 0]
+                else
+                    [following[0] + 1, following[1] + instruction.cycles]
+                end
+            end
+
+            # A block whose following instructions wrap around the end of memory is not found
+            # in address order, so is left as a single instruction.
+            return blocks.select { |_, (instructions, _)| instructions > 1 }
+        end
+
+        # Returns an array of whether each address is read by the primary CPU from read-only memory.
+        def self.readonly(configuration)
+            rom = Array.new(0x10000, false)
+
+            (0...0x10000).each do |address|
+                mem = configuration.memory.find do |m|
+                    configuration.cpu_visible?(m, 0) && address >= m.address && address < m.address + m.size
+                end
+
+                rom[address] = !mem.nil? && mem.readonly?
+            end
+
+            return rom
+        end
+    end
+end
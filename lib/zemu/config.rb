@@ -1,3 +1,5 @@
+require 'etc'
+
 module Zemu
     # Abstract configuration object.
     # All configuration objects should inherit from this.
@@ -73,8 +75,29 @@ module Zemu
     #
     # @param [String] name The name of the configuration.
     # @param [String] compiler The path to the compiler to be used for compiling the emulator executable.
+    # @param [Symbol] build_profile The build profile with which the emulator is compiled. See BUILD_PROFILES.
+    # @param [Array<String>] extra_flags Additional flags passed to the compiler, after those of the build profile.
+    # @param [Integer] build_jobs The maximum number of compiler processes run in parallel when building the emulator.
+    # @param [Boolean] build_static If true, a static archive is built alongside the shared library, for hosts
+    #                               which link the emulator directly through the API declared in src/zemu.h.
+    # @param [String] archiver The path to the archiver used to build the static archive.
     #
     class Config < ConfigObject
+        # Compiler flags for each of the available build profiles.
+        #
+        # * +:release+ - Optimised build. This is the default.
+        # * +:native+ - Fully-optimised build tuned for the host CPU.
+        #   A library built with this profile may not run on other machines.
+        # * +:profile+ - Optimised build with debug symbols and frame pointers,
+        #   for use with sampling profilers such as perf.
+        # * +:debug+ - Unoptimised build with debug symbols, which traps on undefined behaviour.
+        BUILD_PROFILES = {
+            release: %w(-O2),
+            native: %w(-O3 -march=native),
+            profile: %w(-O2 -g -fno-omit-frame-pointer),
+            debug: %w(-O0 -g -fno-omit-frame-pointer -fsanitize=undefined -fsanitize-trap=undefined)
+        }
+
         # Memory object.
         #
         # This is an abstract class from which all other memory objects inherit.
@@ -87,26 +110,46 @@ module Zemu
                     raise NotImplementedError, "Cannot construct an instance of the abstract class Zemu::Config::Memory."
                 end
 
-                @contents = []
+                @contents = "".b
 
                 super
 
                 # Pad contents with 0x00 bytes.
-                (@size - @contents.size).times do
-                    @contents << 0x00
-                end
+                @contents = @contents.ljust(@size, "\x00")
             end
 
-            # Gets or sets an array of bytes representing the initial state
+            # Gets or sets a binary string representing the initial state
             # of this memory block.
+            #
+            # The initial state can be given as a string, or as an array of bytes.
             def contents(*args)
                 if args.size.zero?
                     return @contents
+                elsif args[0].is_a? Array
+                    @contents = args[0].pack("C*")
                 else
-                    @contents = args[0]
+                    @contents = args[0].b
                 end
             end
 
+            # @return [Boolean] true if this memory block is initially filled with 0x00 bytes, false otherwise.
+            def zero?
+                return @contents.count("\x00") == @contents.bytesize
+            end
+
+            # Returns the C initializer list for the contents of this memory block.
+            #
+            # Trailing 0x00 bytes are omitted, as the remainder of the block
+            # is zero-initialized by the compiler.
+            def initializer
+                last = @contents.rindex(/[^\x00]/n)
+                data = last.nil? ? "\x00" : @contents.byteslice(0, last + 1)
+
+                values = data.unpack1("H*").gsub(/(..)/, '0x\1, ')
+
+                return values.scan(/.{1,96}/).map { |line| "\n    " + line }.join
+            end
+
             # @return [Boolean] true if this memory section is readonly, false otherwise.
             def readonly?
                 return false
@@ -114,20 +157,22 @@ module Zemu
 
             # Valid parameters for this object.
             # Should be extended by subclasses but NOT REPLACED.
+            #
+            # +cpus+ gives the names of the CPUs which can access this memory block,
+            # or is empty (the default) if all CPUs can.
             def params
-                return %w(name address size)
+                return %w(name address size cpus)
+            end
+
+            # Initial values for parameters of this object.
+            def params_init
+                return { "cpus" => [] }
             end
 
             # Reads the contents of a file in binary format and
-            # returns them as an array.
+            # returns them as a binary string.
             def from_binary(file)
-                return File.open(file, "rb") do |f|
-                    bin = []
-
-                    f.each_byte { |b| bin << b }
-
-                    bin
-                end
+                return File.binread(file)
             end
         end
 
@@ -232,6 +277,8 @@ module Zemu
                 @read_block = nil
                 @write_block = nil
                 @clock_block = nil
+                @quiet_block = nil
+                @poll_block = nil
 
                 super
             end
@@ -286,6 +333,33 @@ module Zemu
                 @clock_block = block
             end
 
+            # Defines how long this IO device is certain not to interrupt the CPU.
+            #
+            # Expects a block, the return value of which is a string containing a C expression
+            # giving the number of cycles for which the per-cycle behaviour of the IO device
+            # will not raise an interrupt. Batched blocks of instructions only run when no
+            # device would interrupt part way through them. A device with per-cycle behaviour
+            # but no quiet behaviour is taken to be able to interrupt on any cycle.
+            #
+            # The block will be instance-evaluated at build-time, so it is possible to use
+            # instance variables of the IO device.
+            def when_quiet(&block)
+                @quiet_block = block
+            end
+
+            # Defines the behaviour of this IO device when exchanging data with the host.
+            #
+            # Expects a block, the return value of which is a string
+            # defining how the IO device exchanges data with the host through a file descriptor,
+            # given by the C variable "fd". The file descriptor is non-blocking.
+            # This is used, for example, to bridge a serial port to a terminal in interactive mode.
+            #
+            # The block will be instance-evaluated at build-time, so it is possible to use
+            # instance variables of the IO device.
+            def when_poll(&block)
+                @poll_block = block
+            end
+
             # Evaluates the when_setup block of this IO device and returns the resulting string.
             def setup
                 return instance_eval(&@setup_block) unless @setup_block.nil?
@@ -310,6 +384,18 @@ module Zemu
                 return ""
             end
 
+            # Evaluates the when_quiet block of this IO device and returns the resulting string.
+            def quiet
+                return instance_eval(&@quiet_block) unless @quiet_block.nil?
+                return @clock_block.nil? ? "" : "0"
+            end
+
+            # Evaluates the when_poll block of this IO device and returns the resulting string.
+            def poll
+                return instance_eval(&@poll_block) unless @poll_block.nil?
+                return ""
+            end
+
             # Defines FFI API which will be available to the instance wrapper if this IO device is used.
             def functions
                 []
@@ -317,8 +403,17 @@ module Zemu
 
             # Valid parameters for this object.
             # Should be extended by subclasses but NOT REPLACED.
+            #
+            # +cpus+ gives the names of the CPUs which can access this IO device,
+            # or is empty (the default) if all CPUs can. The per-cycle behaviour
+            # of the device is clocked by the first of these CPUs.
             def params
-                %w(name)
+                %w(name cpus)
+            end
+
+            # Initial values for parameters of this object.
+            def params_init
+                return { "cpus" => [] }
             end
         end
         
@@ -352,59 +447,89 @@ module Zemu
                     "SerialBuffer io_#{name}_buffer_master = { .head = 0, .tail = 0 };\n" +
                     "SerialBuffer io_#{name}_buffer_slave = { .head = 0, .tail = 0 };\n" +
                     "\n" +
+                    "/* Serial link to another machine, which replaces the host end of the port if set. */\n" +
+                    "ZemuLink * io_#{name}_link = NULL;\n" +
+                    "zuint8 io_#{name}_link_side = 0;\n" +
+                    "\n" +
+                    "zboolean zemu_io_#{name}_link(ZemuLink * link, zuint8 side)\n" +
+                    "{\n" +
+                    "    if (link != NULL && !zemu_debug_add_link(link, side)) return FALSE;\n" +
+                    "    if (io_#{name}_link != NULL) zemu_debug_remove_link(io_#{name}_link, io_#{name}_link_side);\n" +
+                    "    io_#{name}_link = link;\n" +
+                    "    io_#{name}_link_side = side;\n" +
+                    "    return TRUE;\n" +
+                    "}\n" +
+                    "\n" +
+                    "/* Input fed to the port, which is moved into the receive buffer as space becomes available. */\n" +
+                    "const zuint8 * io_#{name}_feed_data = NULL;\n" +
+                    "zusize io_#{name}_feed_size = 0;\n" +
+                    "\n" +
+                    "/* Empties both buffers of the port, and feeds the given input to it.\n" +
+                    " * The input must remain valid until it has been read, or until the port is fed again.\n" +
+                    " */\n" +
+                    "void zemu_io_#{name}_feed(const zuint8 * data, zusize size)\n" +
+                    "{\n" +
+                    "    io_#{name}_buffer_master.head = io_#{name}_buffer_master.tail = 0;\n" +
+                    "    io_#{name}_buffer_slave.head = io_#{name}_buffer_slave.tail = 0;\n" +
+                    "    io_#{name}_feed_data = data;\n" +
+                    "    io_#{name}_feed_size = size;\n" +
+                    "}\n" +
+                    "\n" +
+                    "/* Moves bytes which have been fed to the port, or have arrived over the link, into the receive buffer. */\n" +
+                    "static void zemu_io_#{name}_receive(void)\n" +
+                    "{\n" +
+                    "    zuint8 c;\n" +
+                    "    while (io_#{name}_feed_size > 0 && zemu_io_serial_buffer_count(&io_#{name}_buffer_master) < ZEMU_IO_SERIAL_BUFFER_SIZE - 1)\n" +
+                    "    {\n" +
+                    "        zemu_io_serial_buffer_put(&io_#{name}_buffer_master, *io_#{name}_feed_data++);\n" +
+                    "        io_#{name}_feed_size--;\n" +
+                    "    }\n" +
+                    "    if (io_#{name}_link == NULL) return;\n" +
+                    "    while (zemu_io_serial_buffer_count(&io_#{name}_buffer_master) < ZEMU_IO_SERIAL_BUFFER_SIZE - 1 &&\n" +
+                    "           zemu_link_receive(io_#{name}_link, io_#{name}_link_side, zemu_debug_now(), &c))\n" +
+                    "    {\n" +
+                    "        zemu_io_serial_buffer_put(&io_#{name}_buffer_master, c);\n" +
+                    "    }\n" +
+                    "}\n" +
+                    "\n" +
                     "zusize zemu_io_#{name}_buffer_size(void)\n" +
                     "{\n" +
-                    "    zusize start = io_#{name}_buffer_slave.head;\n" +
-                    "    zusize end = io_#{name}_buffer_slave.tail\n;" +
-                    "    if (end < start) end += ZEMU_IO_SERIAL_BUFFER_SIZE;\n" +
-                    "    return end - start;\n" +
+                    "    return zemu_io_serial_buffer_count(&io_#{name}_buffer_slave);\n" +
                     "}\n" +
                     "\n" +
                     "void zemu_io_#{name}_slave_puts(zuint8 val)\n" +
                     "{\n" +
-                    "    io_#{name}_buffer_slave.buffer[io_#{name}_buffer_slave.tail] = val;\n" +
-                    "    io_#{name}_buffer_slave.tail++;\n" +
-                    "    if (io_#{name}_buffer_slave.tail >= ZEMU_IO_SERIAL_BUFFER_SIZE)\n" +
-                    "        io_#{name}_buffer_slave.tail = 0;\n" +
+                    "    zemu_debug_output(val);\n" +
+                    "    if (io_#{name}_link != NULL) zemu_link_send(io_#{name}_link, io_#{name}_link_side, val, zemu_debug_now());\n" +
+                    "    else zemu_io_serial_buffer_put(&io_#{name}_buffer_slave, val);\n" +
                     "}\n" +
                     "\n" +
                     "zuint8 zemu_io_#{name}_slave_gets(void)\n" +
                     "{\n" +
-                    "    zuint8 val = io_#{name}_buffer_master.buffer[io_#{name}_buffer_master.head];\n" +
-                    "    io_#{name}_buffer_master.head++;\n" +
-                    "    if (io_#{name}_buffer_master.head >= ZEMU_IO_SERIAL_BUFFER_SIZE)\n" +
-                    "        io_#{name}_buffer_master.head = 0;\n" +
-                    "\n" +
-                    "    return val;\n" +
+                    "    return zemu_io_serial_buffer_get(&io_#{name}_buffer_master);\n" +
                     "}\n" +
                     "\n" +
                     "void zemu_io_#{name}_master_puts(zuint8 val)\n" +
                     "{\n" +
-                    "    io_#{name}_buffer_master.buffer[io_#{name}_buffer_master.tail] = val;\n" +
-                    "    io_#{name}_buffer_master.tail++;\n" +
-                    "    if (io_#{name}_buffer_master.tail >= ZEMU_IO_SERIAL_BUFFER_SIZE)\n" +
-                    "        io_#{name}_buffer_master.tail = 0;\n" +
+                    "    zemu_io_serial_buffer_put(&io_#{name}_buffer_master, val);\n" +
                     "}\n" +
                     "\n" +
                     "zuint8 zemu_io_#{name}_master_gets(void)\n" +
                     "{\n" +
-                    "    zuint8 val = io_#{name}_buffer_slave.buffer[io_#{name}_buffer_slave.head];\n" +
-                    "    io_#{name}_buffer_slave.head++;\n" +
-                    "    if (io_#{name}_buffer_slave.head >= ZEMU_IO_SERIAL_BUFFER_SIZE)\n" +
-                    "        io_#{name}_buffer_slave.head = 0;\n" +
-                    "\n" +
-                    "    return val;\n" +
+                    "    return zemu_io_serial_buffer_get(&io_#{name}_buffer_slave);\n" +
                     "}\n"
                 end
 
                 when_read do
                     "if (port == #{in_port})\n" +
                     "{\n" +
+                    "    zemu_io_#{name}_receive();\n" +
                     "    return zemu_io_#{name}_slave_gets();\n" +
                     "}\n" +
                     "else if (port == #{ready_port})\n" +
                     "{\n" +
-                    "    if (io_#{name}_buffer_master.head == io_#{name}_buffer_master.tail)\n" +
+                    "    zemu_io_#{name}_receive();\n" +
+                    "    if (zemu_io_serial_buffer_count(&io_#{name}_buffer_master) == 0)\n" +
                     "    {\n" +
                     "        return 0;\n" +
                     "    }\n" +
@@ -421,6 +546,19 @@ module Zemu
                     "    zemu_io_#{name}_slave_puts(value);\n" +
                     "}\n"
                 end
+
+                when_poll do
+                    "{\n" +
+                    "    zuint8 c;\n" +
+                    "    if (read(fd, &c, 1) == 1) zemu_io_#{name}_master_puts(c);\n" +
+                    "    struct pollfd p = { .fd = fd, .events = POLLOUT };\n" +
+                    "    if (zemu_io_#{name}_buffer_size() > 0 && poll(&p, 1, 0) == 1)\n" +
+                    "    {\n" +
+                    "        c = zemu_io_#{name}_master_gets();\n" +
+                    "        if (write(fd, &c, 1) != 1) { /* Character is lost if the host closed the descriptor. */ }\n" +
+                    "    }\n" +
+                    "}\n"
+                end
             end
 
             # Defines FFI API which will be available to the instance wrapper if this IO device is used.
@@ -428,7 +566,9 @@ module Zemu
                 [
                     {"name" => "zemu_io_#{name}_master_puts".to_sym, "args" => [:uint8], "return" => :void},
                     {"name" => "zemu_io_#{name}_master_gets".to_sym, "args" => [], "return" => :uint8},
-                    {"name" => "zemu_io_#{name}_buffer_size".to_sym, "args" => [], "return" => :uint64}
+                    {"name" => "zemu_io_#{name}_buffer_size".to_sym, "args" => [], "return" => :uint64},
+                    {"name" => "zemu_io_#{name}_link".to_sym, "args" => [:pointer, :uint8], "return" => :bool},
+                    {"name" => "zemu_io_#{name}_feed".to_sym, "args" => [:pointer, :size_t], "return" => :void}
                 ]
             end
 
@@ -468,6 +608,10 @@ module Zemu
                     "    else zemu_io_nmi(instance);\n" +
                     "}\n"
                 end
+
+                when_quiet do
+                    "io_#{name}_running ? io_#{name}_count : (zusize)-1"
+                end
             end
 
             # Valid parameters for a Timer, along with those defined in
@@ -477,6 +621,298 @@ module Zemu
             end
         end
 
+        # Framebuffer
+        #
+        # Represents a display, the contents of which are written by the CPU through IO ports.
+        # The CPU sets an address in the framebuffer through the low and high address ports,
+        # then writes or reads the data port, which increments the address on each access.
+        #
+        # In +:bitmap+ mode, each byte is a pixel: an index into the palette, which is given
+        # as an array of 0xRRGGBB colours and defaults to 3-3-2 bit RGB. In +:text+ mode,
+        # each byte is a character.
+        #
+        # Only the rows written since the last frame are rendered, and no rendering takes place
+        # if nothing has been written. See Zemu::Instance#frame.
+        class Framebuffer < IOPort
+            # Constructor.
+            #
+            # Takes a block in which the parameters of the framebuffer
+            # can be initialized.
+            #
+            # @example
+            #
+            #   Zemu::Config::Framebuffer.new do
+            #       name "display"
+            #       width 128
+            #       height 64
+            #       address_low_port 0x20
+            #       address_high_port 0x21
+            #       data_port 0x22
+            #   end
+            #
+            # @raise [Zemu::ConfigError] Raised if the framebuffer is larger than 64KB, or the mode is unknown.
+            def initialize
+                super
+
+                @mode = @mode.to_sym
+
+                unless [:bitmap, :text].include? @mode
+                    raise ConfigError, "The mode parameter of a Zemu::Config::Framebuffer configuration object must be :bitmap or :text."
+                end
+
+                if @width < 1 || @height < 1 || @width * @height > 0x10000
+                    raise ConfigError, "The size of a Zemu::Config::Framebuffer configuration object must be between 1 byte and 64KB."
+                end
+
+                when_setup do
+                    "zuint8 io_#{name}_memory[#{width * height}];\n" +
+                    "zuint16 io_#{name}_address = 0;\n" +
+                    "\n" +
+                    "/* Rows written since the last frame was rendered. Initially the whole frame. */\n" +
+                    "zuint8 io_#{name}_dirty_rows[#{height}] = { #{(["1"] * height).join(", ")} };\n" +
+                    "zboolean io_#{name}_dirty = TRUE;\n" +
+                    "\n" +
+                    (bitmap? ?
+                    "zuint8 io_#{name}_frame[#{width * height * 4}];\n" +
+                    "\n" +
+                    "static const zuint32 io_#{name}_palette[256] =\n" +
+                    "{#{colours.each_slice(8).map { |row| "\n    " + row.map { |c| "0x%06x" % c }.join(", ") }.join(",")}\n" +
+                    "};\n"
+                    :
+                    "zuint8 io_#{name}_frame[#{width * height}];\n") +
+                    "\n" +
+                    "zboolean zemu_io_#{name}_dirty(void)\n" +
+                    "{\n" +
+                    "    return io_#{name}_dirty;\n" +
+                    "}\n" +
+                    "\n" +
+                    "/* Renders the rows written since the last frame, and copies the frame to out.\n" +
+                    " * Returns the number of rows rendered.\n" +
+                    " */\n" +
+                    "zusize zemu_io_#{name}_render(zuint8 * out)\n" +
+                    "{\n" +
+                    "    zusize rows = 0;\n" +
+                    "\n" +
+                    "    if (io_#{name}_dirty)\n" +
+                    "    {\n" +
+                    "        io_#{name}_dirty = FALSE;\n" +
+                    "\n" +
+                    "        for (zusize y = 0; y < #{height}; y++)\n" +
+                    "        {\n" +
+                    "            if (!io_#{name}_dirty_rows[y]) continue;\n" +
+                    "            io_#{name}_dirty_rows[y] = 0;\n" +
+                    "            rows++;\n" +
+                    "\n" +
+                    (bitmap? ?
+                    "            for (zusize x = 0; x < #{width}; x++)\n" +
+                    "            {\n" +
+                    "                zuint32 colour = io_#{name}_palette[io_#{name}_memory[y * #{width} + x]];\n" +
+                    "                zuint8 * pixel = io_#{name}_frame + (y * #{width} + x) * 4;\n" +
+                    "                pixel[0] = (colour >> 16) & 0xff;\n" +
+                    "                pixel[1] = (colour >> 8) & 0xff;\n" +
+                    "                pixel[2] = colour & 0xff;\n" +
+                    "                pixel[3] = 0xff;\n" +
+                    "            }\n"
+                    :
+                    "            memcpy(io_#{name}_frame + y * #{width}, io_#{name}_memory + y * #{width}, #{width});\n") +
+                    "        }\n" +
+                    "    }\n" +
+                    "\n" +
+                    "    if (out != NULL) memcpy(out, io_#{name}_frame, sizeof(io_#{name}_frame));\n" +
+                    "\n" +
+                    "    return rows;\n" +
+                    "}\n"
+                end
+
+                when_read do
+                    "if (port == #{address_low_port})\n" +
+                    "{\n" +
+                    "    return io_#{name}_address & 0xff;\n" +
+                    "}\n" +
+                    "else if (port == #{address_high_port})\n" +
+                    "{\n" +
+                    "    return io_#{name}_address >> 8;\n" +
+                    "}\n" +
+                    "else if (port == #{data_port})\n" +
+                    "{\n" +
+                    "    zuint32 address = io_#{name}_address++;\n" +
+                    "    return (address < #{width * height}) ? io_#{name}_memory[address] : 0;\n" +
+                    "}\n"
+                end
+
+                when_write do
+                    "if (port == #{address_low_port})\n" +
+                    "{\n" +
+                    "    io_#{name}_address = (io_#{name}_address & 0xff00) | value;\n" +
+                    "}\n" +
+                    "else if (port == #{address_high_port})\n" +
+                    "{\n" +
+                    "    io_#{name}_address = (io_#{name}_address & 0x00ff) | (value << 8);\n" +
+                    "}\n" +
+                    "else if (port == #{data_port})\n" +
+                    "{\n" +
+                    "    zuint32 address = io_#{name}_address++;\n" +
+                    "    if (address < #{width * height} && io_#{name}_memory[address] != value)\n" +
+                    "    {\n" +
+                    "        io_#{name}_memory[address] = value;\n" +
+                    "        io_#{name}_dirty_rows[address / #{width}] = 1;\n" +
+                    "        io_#{name}_dirty = TRUE;\n" +
+                    "    }\n" +
+                    "}\n"
+                end
+            end
+
+            # @return [Boolean] true if this framebuffer is in bitmap mode, false if in text mode.
+            def bitmap?
+                return @mode == :bitmap
+            end
+
+            # Returns the 256 colours of the palette, as 0xRRGGBB values.
+            def colours
+                default = Array.new(256) do |i|
+                    ((((i >> 5) & 7) * 255 / 7) << 16) | ((((i >> 2) & 7) * 255 / 7) << 8) | ((i & 3) * 255 / 3)
+                end
+
+                return @palette.first(256) + default[[@palette.size, 256].min..-1].to_a
+            end
+
+            # Defines FFI API which will be available to the instance wrapper if this IO device is used.
+            def functions
+                [
+                    {"name" => "zemu_io_#{name}_dirty".to_sym, "args" => [], "return" => :bool},
+                    {"name" => "zemu_io_#{name}_render".to_sym, "args" => [:pointer], "return" => :size_t}
+                ]
+            end
+
+            # Valid parameters for a Framebuffer, along with those defined in
+            # [Zemu::Config::IOPort].
+            def params
+                super + %w(width height mode palette address_low_port address_high_port data_port)
+            end
+
+            # Initial values for parameters of a Framebuffer.
+            def params_init
+                super.merge({ "mode" => :bitmap, "palette" => [] })
+            end
+        end
+
+        # Mailbox
+        #
+        # Represents a pair of one-byte mailboxes connecting two CPUs of a multi-CPU
+        # configuration, one for each direction. Each CPU sends a byte by writing to the
+        # data port, and receives a byte by reading from it. Reading the status port
+        # gives bit 0 set if a byte is waiting to be received, and bit 1 set if a byte
+        # can be sent. A byte sent while the mailbox is full is lost.
+        #
+        # The +cpus+ parameter must name exactly two CPUs.
+        class Mailbox < IOPort
+            # Constructor.
+            #
+            # Takes a block in which the parameters of the mailbox
+            # can be initialized.
+            #
+            # @example
+            #
+            #   Zemu::Config::Mailbox.new do
+            #       name "mailbox"
+            #       cpus ["main", "sound"]
+            #       data_port 0x10
+            #       status_port 0x11
+            #   end
+            #
+            # @raise [Zemu::ConfigError] Raised if the +cpus+ parameter does not name two CPUs.
+            def initialize
+                super
+
+                if @cpus.size != 2
+                    raise ConfigError, "The cpus parameter of a Zemu::Config::Mailbox configuration object must name two CPUs."
+                end
+
+                when_setup do
+                    "/* Mailbox \"#{name}\": index 0 holds the byte sent to CPU \"#{cpus[0]}\", index 1 that sent to CPU \"#{cpus[1]}\". */\n" +
+                    "zuint8 io_#{name}_data[2];\n" +
+                    "zuint8 io_#{name}_full[2] = { 0, 0 };\n"
+                end
+
+                when_read do
+                    "if (port == #{data_port})\n" +
+                    "{\n" +
+                    "    zusize side = (cpu == ZEMU_CPU_#{cpus[0].upcase}) ? 0 : 1;\n" +
+                    "    io_#{name}_full[side] = 0;\n" +
+                    "    return io_#{name}_data[side];\n" +
+                    "}\n" +
+                    "else if (port == #{status_port})\n" +
+                    "{\n" +
+                    "    zusize side = (cpu == ZEMU_CPU_#{cpus[0].upcase}) ? 0 : 1;\n" +
+                    "    return io_#{name}_full[side] | (io_#{name}_full[1 - side] ? 0 : 2);\n" +
+                    "}\n"
+                end
+
+                when_write do
+                    "if (port == #{data_port})\n" +
+                    "{\n" +
+                    "    zusize side = (cpu == ZEMU_CPU_#{cpus[0].upcase}) ? 1 : 0;\n" +
+                    "    if (!io_#{name}_full[side])\n" +
+                    "    {\n" +
+                    "        io_#{name}_data[side] = value;\n" +
+                    "        io_#{name}_full[side] = 1;\n" +
+                    "    }\n" +
+                    "}\n"
+                end
+            end
+
+            # Valid parameters for a Mailbox, along with those defined in
+            # [Zemu::Config::IOPort].
+            def params
+                super + %w(data_port status_port)
+            end
+        end
+
+        # CPU object.
+        #
+        # Represents one of the CPUs of a multi-CPU configuration. Each CPU has its own
+        # registers and clock, and sees the memory blocks and IO devices which list it in
+        # their +cpus+ parameter, or which do not restrict their CPUs.
+        #
+        # The first CPU added to a configuration is the primary CPU: it is the CPU controlled
+        # by the methods of Zemu::Instance, and the other CPUs are run in lockstep with it.
+        # A configuration with no CPUs has a single primary CPU named "main".
+        #
+        # @param [String] name The name of the CPU. Must be a valid C identifier.
+        # @param [Integer] clock_speed The clock speed of the CPU in Hz, or 0 (the default)
+        #                              to use the clock speed of the configuration.
+        class CPU < ConfigObject
+            # Constructor.
+            #
+            # Takes a block in which the parameters of the CPU can be initialized.
+            #
+            # @example
+            #
+            #   Zemu::Config::CPU.new do
+            #       name "sound"
+            #       clock_speed 3_579_545
+            #   end
+            #
+            # @raise [Zemu::ConfigError] Raised if the +name+ parameter is not a valid C identifier.
+            def initialize
+                super
+
+                unless /\A[A-Za-z_][A-Za-z0-9_]*\z/ =~ @name
+                    raise ConfigError, "The name parameter of a Zemu::Config::CPU configuration object must be a valid C identifier."
+                end
+            end
+
+            # Valid parameters for a CPU.
+            def params
+                return %w(name clock_speed)
+            end
+
+            # Initial values for parameters of a CPU.
+            def params_init
+                return { "clock_speed" => 0 }
+            end
+        end
+
         # Gets a binding for this object.
         def get_binding
             return binding
@@ -489,8 +925,18 @@ module Zemu
         attr_reader :io
 
         # Parameters accessible by this configuration object.
+        #
+        # +cpu_quantum+ is the number of cycles of the primary CPU between each
+        # synchronisation of the other CPUs of a multi-CPU configuration.
+        #
+        # +batch_blocks+ enables the batching of straight-line code in read-only memory, found
+        # when the library is built from the reset and interrupt vectors and from +entry_points+.
+        # See Zemu::Blocks.
+        #
+        # +heatmap+ enables the counting of reads, writes and opcode fetches of each page of memory.
+        # See Instance#heatmap.
         def params
-            return %w(name compiler output_directory clock_speed serial_delay)
+            return %w(name compiler output_directory clock_speed serial_delay build_profile extra_flags build_jobs cpu_quantum build_static archiver batch_blocks entry_points heatmap)
         end
 
         # Initial value for parameters of this configuration object.
@@ -499,7 +945,16 @@ module Zemu
                 "compiler" => "clang",
                 "output_directory" => "bin",
                 "clock_speed" => 0,
-                "serial_delay" => 0
+                "serial_delay" => 0,
+                "build_profile" => :release,
+                "extra_flags" => [],
+                "build_jobs" => Etc.nprocessors,
+                "cpu_quantum" => 64,
+                "build_static" => false,
+                "archiver" => "ar",
+                "batch_blocks" => false,
+                "entry_points" => [],
+                "heatmap" => false
             }
         end
 
@@ -524,9 +979,11 @@ module Zemu
         #   end
         #
         # @raise [Zemu::ConfigError] Raised if the +name+ parameter is not set, or contains whitespace.
+        # @raise [Zemu::ConfigError] Raised if the +build_profile+ parameter is not a known build profile.
         def initialize
             @memory = []
             @io = []
+            @cpus = []
 
             super
 
@@ -537,6 +994,146 @@ module Zemu
             if /\s/ =~ @name
                 raise ConfigError, "The name parameter of a Zemu::Config configuration object cannot contain whitespace."
             end
+
+            @build_profile = @build_profile.to_sym
+
+            unless BUILD_PROFILES.key? @build_profile
+                raise ConfigError, "The build_profile parameter of a Zemu::Config configuration object must be one of: #{BUILD_PROFILES.keys.join(", ")}."
+            end
+
+            names = cpus.map(&:name)
+
+            if names.uniq.size != names.size
+                raise ConfigError, "The CPUs of a Zemu::Config configuration object must have unique names."
+            end
+
+            (@memory + @io).each do |object|
+                unknown = object.cpus.map(&:to_s) - names
+                unless unknown.empty?
+                    raise ConfigError, "The #{object.name} #{object.class.name} configuration object uses unknown CPUs: #{unknown.join(", ")}."
+                end
+            end
+
+            if @cpu_quantum < 1
+                raise ConfigError, "The cpu_quantum parameter of a Zemu::Config configuration object must be positive."
+            end
+
+            unless @entry_points.all? { |address| address.is_a?(Integer) && address >= 0 && address <= 0xffff }
+                raise ConfigError, "The entry_points parameter of a Zemu::Config configuration object must contain 16-bit addresses."
+            end
+        end
+
+        # The CPUs of this configuration, the first being the primary CPU.
+        #
+        # A configuration to which no CPUs have been added has a single CPU, named "main".
+        def cpus
+            return @cpus unless @cpus.empty?
+
+            clock = @clock_speed
+            return [CPU.new { name "main"; clock_speed clock }]
+        end
+
+        # Returns the index of the CPU with the given name, or nil if there is no such CPU.
+        def cpu_index(name)
+            return cpus.index { |cpu| cpu.name == name.to_s }
+        end
+
+        # Returns the bitmask of CPUs which can access the given memory block or IO device,
+        # or nil if all CPUs can access it.
+        def cpu_mask(object)
+            return nil if object.cpus.empty?
+            return object.cpus.map { |name| 1 << cpu_index(name) }.reduce(:|)
+        end
+
+        # Returns true if the CPU with the given index can access the given memory block or IO device.
+        def cpu_visible?(object, index)
+            mask = cpu_mask(object)
+            return mask.nil? || (mask & (1 << index)) != 0
+        end
+
+        # Returns the C condition, followed by "&&", under which the CPU given by the C variable "cpu"
+        # can access the given memory block or IO device, or an empty string if all CPUs can access it.
+        def cpu_check(object)
+            mask = cpu_mask(object)
+            return "" if mask.nil?
+            return "(0x#{mask.to_s(16)}u & (1u << cpu)) && "
+        end
+
+        # Returns the index of the CPU which clocks the given IO device:
+        # the first CPU which can access it.
+        def cpu_owner(object)
+            return 0 if object.cpus.empty?
+            return cpu_index(object.cpus.first)
+        end
+
+        # Returns the number of cycles each CPU runs for each cycle of the primary CPU,
+        # as determined by their clock speeds.
+        #
+        # A CPU without a clock speed runs at the same rate as the primary CPU.
+        def cpu_rates
+            speeds = cpus.map { |cpu| cpu.clock_speed > 0 ? cpu.clock_speed : @clock_speed }
+            primary = speeds.first
+
+            return speeds.map { |speed| (primary > 0 && speed > 0) ? speed.to_f / primary : 1.0 }
+        end
+
+        # Returns the C initializer of the page table through which the CPU with the given index
+        # reads (or, if +write+ is true, writes) memory: a pointer for each 256-byte page.
+        #
+        # A page entirely within one memory block, and overlapped by no other block which takes
+        # precedence for the access, points to its place in that block. A page overlapped by no
+        # memory block reads from a page of zeros, and is NULL for writes. Any other page is NULL,
+        # and is accessed by searching the memory blocks.
+        def page_table(index, write: false)
+            blocks = memory.select { |mem| cpu_visible?(mem, index) && !(write && mem.readonly?) }
+
+            pages = (0...0x100).map do |page|
+                start = page << 8
+                overlapping = blocks.select { |mem| mem.address < start + 0x100 && mem.address + mem.size > start }
+
+                # Reads are from the first block containing an address, and writes are to every such block.
+                mem = overlapping.first
+                whole = !mem.nil? && mem.address <= start && mem.address + mem.size >= start + 0x100
+
+                if overlapping.empty?
+                    write ? "NULL" : "zemu_memory_unmapped"
+                elsif whole && (!write || overlapping.size == 1)
+                    "zemu_memory_block_#{mem.name} + 0x#{(start - mem.address).to_s(16)}"
+                else
+                    "NULL"
+                end
+            end
+
+            return pages.each_slice(4).map { |slice| slice.join(", ") }.join(",\n        ")
+        end
+
+        # The compiler flags for this configuration, as determined by
+        # the build profile and any extra flags.
+        def compiler_flags
+            return BUILD_PROFILES[@build_profile] + @extra_flags
+        end
+
+        # The name of the library built for this configuration.
+        #
+        # Includes the build profile, so that libraries built with different
+        # profiles can exist side-by-side in the same output directory.
+        def library_name
+            return "#{@name}_#{@build_profile}.so"
+        end
+
+        # The path of the library built for this configuration.
+        def library
+            return File.join(@output_directory, library_name)
+        end
+
+        # The path of the static archive built for this configuration, if +build_static+ is set.
+        def archive
+            return File.join(@output_directory, "#{@name}_#{@build_profile}.a")
+        end
+
+        # The path of the libFuzzer target built for this configuration by Zemu::build_fuzzer.
+        def fuzzer
+            return File.join(@output_directory, "#{@name}_#{@build_profile}_fuzz")
         end
 
         # Adds a new memory section to this configuration.
@@ -552,6 +1149,13 @@ module Zemu
         def add_io(io)
             @io << io
         end
+
+        # Adds a new CPU to this configuration.
+        #
+        # @param [Zemu::Config::CPU] cpu The CPU to add.
+        def add_cpu(cpu)
+            @cpus << cpu
+        end
     end
 
     # Error raised when a configuration is initialized incorrectly.
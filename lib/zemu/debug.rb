@@ -16,13 +16,209 @@ module Zemu
                     end
 
                     symbols[s.address] << s
-                    symbols[s.address].sort_by!(&:label)
                 end
             end
 
+            symbols.each_value { |syms| syms.sort_by!(&:label) }
+
             return symbols
         end
+
+        # A table of symbols, indexed for fast lookup by address and by label.
+        #
+        # Symbols are held in arrays sorted by address, so that the symbol nearest
+        # to (at or before) any address can be found with a binary search.
+        #
+        # @example
+        #
+        #   table = Zemu::Debug::SymbolTable.load_map("app.map")
+        #
+        #   symbol, offset = table.lookup(0x1234)
+        #   puts "#{symbol.label}+#{offset}" unless symbol.nil?
+        #
+        #   puts table.address_of("main")
+        class SymbolTable
+            # Magic number at the start of a serialized symbol table.
+            MAGIC = "ZSYM"
+
+            # Loads a symbol table from one or more map files.
+            #
+            # @param [Array<String>] paths Paths to map files in `label = address` format.
+            def self.load_map(*paths)
+                table = self.new
+
+                paths.each do |path|
+                    table.add(Debug.load_map(path).values.flatten)
+                end
+
+                return table
+            end
+
+            # Loads a symbol table from a string given by SymbolTable#serialize.
+            #
+            # @raise [ArgumentError] Raised if the string is not a serialized symbol table.
+            def self.deserialize(data)
+                data = data.b
+
+                unless data.start_with? MAGIC
+                    raise ArgumentError, "Not a serialized symbol table."
+                end
+
+                count = data.byteslice(MAGIC.size, 4).unpack1("V")
+                addresses = data.byteslice(MAGIC.size + 4, count * 4).unpack("V*")
+                labels = data.byteslice((MAGIC.size + 4 + (count * 4))..-1).split("\n")
+
+                return self.new(labels.zip(addresses).map { |l, a| Symbol.new(l, a) })
+            end
+
+            # Constructor.
+            #
+            # @param [Array<Symbol>] symbols The symbols in the table.
+            def initialize(symbols=[])
+                @symbols = []
+                add(symbols)
+            end
+
+            # Adds symbols to this table.
+            #
+            # @param [Array<Symbol>] symbols The symbols to add.
+            def add(symbols)
+                @symbols = (@symbols + symbols).uniq { |s| [s.address, s.label] }.sort_by { |s| [s.address, s.label] }
+
+                @addresses = []
+                @first = []
+                @labels = {}
+
+                @symbols.each_with_index do |s, i|
+                    if @addresses.last != s.address
+                        @addresses << s.address
+                        @first << i
+                    end
+
+                    @labels[s.label] = s.address
+                end
+
+                return self
+            end
+
+            # Adds the symbols of another table to this table.
+            def merge!(other)
+                return add(other.to_a)
+            end
+
+            # Returns all symbols in this table, sorted by address and then by label.
+            def to_a
+                return @symbols.dup
+            end
+
+            # Returns the number of symbols in this table.
+            def size
+                return @symbols.size
+            end
+
+            # Returns true if this table contains no symbols.
+            def empty?
+                return @symbols.empty?
+            end
+
+            # Returns the symbols defined at exactly the given address, sorted by label.
+            def [](address)
+                i = index(address)
+                return [] if i.nil? || @addresses[i] != address
+
+                last = (i + 1 < @first.size) ? @first[i + 1] : @symbols.size
+                return @symbols[@first[i]...last]
+            end
+
+            # Finds the symbol at or nearest before the given address.
+            #
+            # @returns A pair of the symbol and the offset of the address from it,
+            #          or nil if there is no symbol at or before the address.
+            def lookup(address)
+                i = index(address)
+                return nil if i.nil?
+
+                return [@symbols[@first[i]], address - @addresses[i]]
+            end
+
+            # Returns the address of the symbol with the given label, or nil if there is no such symbol.
+            def address_of(label)
+                return @labels[label]
+            end
+
+            # Returns a compact binary representation of this table,
+            # which can be loaded with SymbolTable.deserialize.
+            def serialize
+                return MAGIC + [@symbols.size].pack("V") + @symbols.map(&:address).pack("V*") + @symbols.map(&:label).join("\n")
+            end
+
+            # Index into the address array of the greatest address not greater than the given address.
+            def index(address)
+                after = @addresses.bsearch_index { |a| a > address } || @addresses.size
+                return (after.zero? ? nil : after - 1)
+            end
+
+            private :index
+        end
         
+        # Represents a disassembled instruction.
+        class Instruction
+            # Flags describing the control flow of an instruction, as defined in disassemble.h.
+            FLAGS = {
+                branch: 0x01,
+                conditional: 0x02,
+                call: 0x04,
+                return: 0x08,
+                repeat: 0x10,
+                loop: 0x20,
+                halt: 0x40
+            }
+
+            # Address of this instruction.
+            attr_reader :address
+
+            # Length of this instruction in bytes.
+            attr_reader :length
+
+            # Mnemonic of this instruction, e.g. "LD".
+            attr_reader :mnemonic
+
+            # Operands of this instruction, e.g. "A,(HL)".
+            attr_reader :operands
+
+            # Number of T-states taken by this instruction, if its condition is false
+            # or on the final iteration of a repeating instruction.
+            attr_reader :cycles
+
+            # Number of T-states taken by this instruction, if its condition is true
+            # or on a repeated iteration of a repeating instruction.
+            attr_reader :cycles_taken
+
+            # Address to which this instruction branches, or nil if it does not
+            # branch or the target is not known until it is executed.
+            attr_reader :target
+
+            def initialize(address, length, mnemonic, operands, cycles, cycles_taken, target, flags)
+                @address = address
+                @length = length
+                @mnemonic = mnemonic
+                @operands = operands
+                @cycles = cycles
+                @cycles_taken = cycles_taken
+                @target = target
+                @flags = flags
+            end
+
+            FLAGS.each do |name, mask|
+                define_method("#{name}?") { (@flags & mask) != 0 }
+            end
+
+            # Returns the textual form of this instruction, e.g. "LD A,(HL)".
+            def to_s
+                return @operands.empty? ? @mnemonic : "#{@mnemonic} #{@operands}"
+            end
+        end
+
         # Represents a symbol definition, of the form `label = address`.
         class Symbol
             # Parse a symbol definition, returning a Symbol instance.
@@ -64,5 +260,207 @@ module Zemu
                 @address = address
             end
         end
+
+        # A breakpoint condition, compiled to the bytecode evaluated natively by condition.c.
+        #
+        # Conditions are C-like expressions over:
+        # * registers, e.g. +A+, +HL+, +IX+, +B'+
+        # * numbers, e.g. +66+, +0x42+, +$42+
+        # * memory, as in Z80 assembly: +(HL)+ is the byte at the address in HL
+        # * +hits+, the number of times the breakpoint has been hit, including this one
+        # * +cycles+, the number of cycles executed since the instance started
+        #
+        # Square brackets group subexpressions, as parentheses denote memory.
+        #
+        # @example
+        #   Zemu::Debug::Condition.new("A == 0x42 && (HL) != 0")
+        #   Zemu::Debug::Condition.new("[hits & 0xff] == 0 || cycles > 1000000")
+        class Condition
+            # Opcodes, as defined in condition.h.
+            OPCODES = {
+                end: 0x00,
+                constant: 0x01,
+                register: 0x02,
+                memory: 0x03,
+                hits: 0x04,
+                cycles: 0x05,
+
+                "!" => 0x10,
+                "-@" => 0x11,
+                "~" => 0x12,
+
+                "+" => 0x20,
+                "-" => 0x21,
+                "&" => 0x22,
+                "|" => 0x23,
+                "^" => 0x24,
+                "<<" => 0x25,
+                ">>" => 0x26,
+                "==" => 0x27,
+                "!=" => 0x28,
+                "<" => 0x29,
+                "<=" => 0x2A,
+                ">" => 0x2B,
+                ">=" => 0x2C,
+                "&&" => 0x2D,
+                "||" => 0x2E
+            }
+
+            # Binary operators, from lowest to highest precedence.
+            PRECEDENCE = [
+                ["||"],
+                ["&&"],
+                ["|"],
+                ["^"],
+                ["&"],
+                ["==", "!="],
+                ["<", "<=", ">", ">="],
+                ["<<", ">>"],
+                ["+", "-"]
+            ]
+
+            # Register pairs, made from the 8-bit registers known to Instance.
+            PAIRS = %w(AF BC DE HL AF' BC' DE' HL')
+
+            # Maximum depth of the evaluation stack, and length of the bytecode, as defined in condition.h and debug.h.
+            MAX_DEPTH = 32
+            MAX_LENGTH = 256
+
+            # Pattern matching a single token.
+            TOKEN = /\s*(0x\h+|\$\h+|\d+|[A-Za-z]+'?|==|!=|<=|>=|<<|>>|&&|\|\||[()\[\]!~+\-&|^<>])/
+
+            # The expression from which this condition was compiled.
+            attr_reader :expression
+
+            # The compiled bytecode, as a binary string.
+            attr_reader :bytecode
+
+            # Compiles the given expression.
+            #
+            # @raise [ArgumentError] Raised if the expression is invalid.
+            def initialize(expression)
+                @expression = expression
+                @tokens = tokenize(expression)
+                @bytecode = "".b
+                @depth = 0
+
+                parse_binary(0)
+                raise ArgumentError, "Unexpected '#{@tokens.first}' in condition: '#{expression}'" unless @tokens.empty?
+
+                emit(:end)
+                raise ArgumentError, "Condition too long: '#{expression}'" if @bytecode.bytesize > MAX_LENGTH
+            end
+
+            # Splits an expression into tokens.
+            def tokenize(expression)
+                tokens = []
+                rest = expression.strip
+
+                until rest.empty?
+                    match = TOKEN.match(rest)
+                    raise ArgumentError, "Invalid condition: '#{expression}'" if match.nil? || match.begin(0) != 0
+
+                    tokens << match[1]
+                    rest = match.post_match.strip
+                end
+
+                return tokens
+            end
+
+            # Parses binary operators of the given precedence level and above.
+            def parse_binary(level)
+                return parse_unary if level >= PRECEDENCE.size
+
+                parse_binary(level + 1)
+
+                while PRECEDENCE[level].include?(@tokens.first)
+                    operator = @tokens.shift
+                    parse_binary(level + 1)
+                    emit(operator)
+                    @depth -= 1
+                end
+            end
+
+            # Parses unary operators and operands.
+            def parse_unary
+                token = @tokens.shift
+                raise ArgumentError, "Unexpected end of condition: '#{@expression}'" if token.nil?
+
+                case token
+                when "!", "~"
+                    parse_unary
+                    emit(token)
+                when "-"
+                    parse_unary
+                    emit("-@")
+                when "("
+                    parse_binary(0)
+                    expect(")")
+                    emit(:memory)
+                when "["
+                    parse_binary(0)
+                    expect("]")
+                when /\A0x(\h+)\z/, /\A\$(\h+)\z/
+                    push_constant($1.to_i(16))
+                when /\A\d+\z/
+                    push_constant(token.to_i)
+                else
+                    parse_name(token)
+                end
+            end
+
+            # Parses a register name or keyword.
+            def parse_name(token)
+                name = token.upcase
+
+                if name == "HITS" || name == "CYCLES"
+                    push(name.downcase.to_sym)
+                elsif PAIRS.include?(name)
+                    # (high << 8) | low
+                    push_register(name[0] + name[2..-1].to_s)
+                    push_constant(8)
+                    emit("<<")
+                    @depth -= 1
+                    push_register(name[1..-1])
+                    emit("|")
+                    @depth -= 1
+                elsif Instance::REGISTERS.key?(name)
+                    push_register(name)
+                else
+                    raise ArgumentError, "Unknown register or keyword '#{token}' in condition: '#{@expression}'"
+                end
+            end
+
+            # Consumes the given token, which must be next.
+            def expect(token)
+                actual = @tokens.shift
+                raise ArgumentError, "Expected '#{token}' in condition: '#{@expression}'" unless actual == token
+            end
+
+            # Appends an opcode, and any operand bytes.
+            def emit(op, operand="".b)
+                @bytecode << OPCODES[op].chr << operand
+            end
+
+            # Appends an opcode which pushes a value onto the stack.
+            def push(op, operand="".b)
+                @depth += 1
+                raise ArgumentError, "Condition too complex: '#{@expression}'" if @depth > MAX_DEPTH
+
+                emit(op, operand)
+            end
+
+            # Appends an opcode which pushes a constant.
+            def push_constant(value)
+                push(:constant, [value].pack("Q<"))
+            end
+
+            # Appends an opcode which pushes the register with the given name.
+            def push_register(name)
+                push(:register, Instance::REGISTERS[name].chr)
+            end
+
+            private :tokenize, :parse_binary, :parse_unary, :parse_name, :expect, :emit, :push, :push_constant, :push_register
+        end
     end
 end
@@ -0,0 +1,78 @@
+require 'zlib'
+
+module Zemu
+    # A frame rendered by a Zemu::Config::Framebuffer in bitmap mode.
+    #
+    # Frames are immutable, and can be compared to detect changes to the display.
+    class Frame
+        # The width of the frame in pixels.
+        attr_reader :width
+
+        # The height of the frame in pixels.
+        attr_reader :height
+
+        # The raw contents of the frame, as a binary string of RGBA pixels, row by row.
+        attr_reader :rgba
+
+        # Constructor.
+        #
+        # @param width The width of the frame in pixels.
+        # @param height The height of the frame in pixels.
+        # @param rgba The contents of the frame, as a binary string of RGBA pixels.
+        def initialize(width, height, rgba)
+            @width = width
+            @height = height
+            @rgba = rgba.b.freeze
+        end
+
+        # Returns the colour of the pixel at the given coordinates as [red, green, blue].
+        def pixel(x, y)
+            return @rgba.byteslice((y * @width + x) * 4, 3).bytes
+        end
+
+        # Returns true if the other frame has the same size and contents as this one.
+        def ==(other)
+            return other.is_a?(Frame) && other.width == @width && other.height == @height && other.rgba == @rgba
+        end
+
+        # Encodes this frame as a binary PPM (P6) image.
+        def to_ppm
+            rgb = @rgba.unpack("a3x" * (@width * @height)).join
+            return "P6\n#{@width} #{@height}\n255\n".b + rgb
+        end
+
+        # Encodes this frame as a PNG image.
+        def to_png
+            # Each row is preceded by its filter type, which is always 0 (none).
+            rows = Array.new(@height) { |y| "\x00".b + @rgba.byteslice(y * @width * 4, @width * 4) }.join
+
+            header = [@width, @height, 8, 6, 0, 0, 0].pack("NNCCCCC")
+
+            return "\x89PNG\r\n\x1a\n".b +
+                   png_chunk("IHDR", header) +
+                   png_chunk("IDAT", Zlib::Deflate.deflate(rows)) +
+                   png_chunk("IEND", "".b)
+        end
+
+        # Writes this frame to a file: as a PNG image if the path ends in ".png",
+        # as a PPM image if it ends in ".ppm", and as raw RGBA pixels otherwise.
+        #
+        # @param path The path of the file.
+        def save(path)
+            contents = case File.extname(path).downcase
+                when ".png" then to_png
+                when ".ppm" then to_ppm
+                else @rgba
+            end
+
+            File.binwrite(path, contents)
+        end
+
+        # Encodes a PNG chunk of the given type.
+        def png_chunk(type, data)
+            return [data.bytesize].pack("N") + type.b + data + [Zlib.crc32(type + data)].pack("N")
+        end
+
+        private :png_chunk
+    end
+end
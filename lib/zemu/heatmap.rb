@@ -0,0 +1,99 @@
+require 'json'
+
+module Zemu
+    # Counts of the reads, writes and opcode fetches of each 256-byte page of memory,
+    # made by an instance built with the +heatmap+ parameter set. See Instance#heatmap.
+    #
+    # A read at the address in PC is counted as an opcode fetch, which only approximates
+    # the true fetches: see Instance#heatmap. Writes to read-only and unmapped memory are
+    # counted, so that unexpected writes can be found.
+    class Heatmap
+        # Number of pages in the address space.
+        PAGES = 0x100
+
+        # Characters used to draw the heatmap, from no accesses to the most accesses.
+        SHADES = " .:-=+*#%@"
+
+        # The number of reads of each page.
+        attr_reader :reads
+
+        # The number of writes to each page.
+        attr_reader :writes
+
+        # The number of reads of each page at the address in PC, approximating opcode fetches.
+        attr_reader :fetches
+
+        # Constructor.
+        #
+        # @param reads The number of reads of each page.
+        # @param writes The number of writes to each page.
+        # @param fetches The number of opcode fetches from each page.
+        # @param memory The memory blocks of the configuration, as [name, address, size].
+        def initialize(reads, writes, fetches, memory=[])
+            @reads = reads.dup.freeze
+            @writes = writes.dup.freeze
+            @fetches = fetches.dup.freeze
+            @memory = memory
+        end
+
+        # Returns the counts of accesses to the page containing the given address,
+        # as a hash of "reads", "writes" and "fetches".
+        def page(address)
+            index = (address >> 8) & 0xff
+            return { "reads" => @reads[index], "writes" => @writes[index], "fetches" => @fetches[index] }
+        end
+
+        # Returns the counts of accesses to each memory block, as a hash from the name
+        # of the block to a hash of "reads", "writes" and "fetches".
+        #
+        # Counts are kept by page, so a page shared between blocks counts towards each of them.
+        def blocks
+            return @memory.map do |name, address, size|
+                pages = ((address >> 8)..((address + size - 1) >> 8))
+                [name, { "reads" => pages.sum { |p| @reads[p] },
+                         "writes" => pages.sum { |p| @writes[p] },
+                         "fetches" => pages.sum { |p| @fetches[p] } }]
+            end.to_h
+        end
+
+        # Returns the heatmap as a hash of the pages which have been accessed,
+        # keyed by the address of the page, and of the memory blocks.
+        def to_h
+            pages = (0...PAGES).reject { |p| @reads[p] + @writes[p] + @fetches[p] == 0 }
+
+            return {
+                "pages" => pages.map { |p| ["0x%04x" % (p << 8), page(p << 8)] }.to_h,
+                "blocks" => blocks
+            }
+        end
+
+        # Returns the heatmap as JSON. See Heatmap#to_h.
+        def to_json(*args)
+            return to_h.to_json(*args)
+        end
+
+        # Returns the heatmap as text: a grid of the accesses of all types to each page,
+        # with a row for each 4 KiB of memory labelled by its first address, shaded on a
+        # logarithmic scale, followed by the counts for each memory block.
+        def to_s
+            totals = (0...PAGES).map { |p| @reads[p] + @writes[p] + @fetches[p] }
+            scale = Math.log2(totals.max + 1)
+
+            lines = ["       " + (0...16).map { |i| i.to_s(16) }.join]
+
+            totals.each_slice(16).with_index do |row, r|
+                shades = row.map do |total|
+                    total.zero? ? SHADES[0] : SHADES[1 + ((Math.log2(total + 1) / scale) * (SHADES.size - 2)).floor]
+                end
+
+                lines << ("0x%04x " % (r << 12)) + shades.join
+            end
+
+            blocks.each do |name, counts|
+                lines << "%-16s reads %-12d writes %-12d fetches %d" % [name, counts["reads"], counts["writes"], counts["fetches"]]
+            end
+
+            return lines.join("\n")
+        end
+    end
+end
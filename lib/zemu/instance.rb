@@ -1,4 +1,5 @@
 require 'ffi'
+require 'fileutils'
 require 'ostruct'
 
 module Zemu
@@ -34,7 +35,56 @@ module Zemu
             "D'" => 16,
             "E'" => 17,
             "H'" => 18,
-            "L'" => 19
+            "L'" => 19,
+
+            # Interrupt and refresh registers, and interrupt state
+            "I" => 20,
+            "R" => 21,
+            "IFF1" => 22,
+            "IFF2" => 23,
+            "IM" => 24
+        }
+
+        # Layout of a disassembled instruction, as defined in disassemble.h.
+        class InstructionStruct < FFI::Struct
+            layout :address, :uint16,
+                   :target, :uint16,
+                   :length, :uint8,
+                   :cycles, :uint8,
+                   :cycles_taken, :uint8,
+                   :flags, :uint8,
+                   :mnemonic, [:char, 6],
+                   :operands, [:char, 18]
+        end
+
+        # Layout of the full state of the CPU, as defined in debug.h.
+        class StateStruct < FFI::Struct
+            layout :pc, :uint16,
+                   :sp, :uint16,
+                   :af, :uint16,
+                   :bc, :uint16,
+                   :de, :uint16,
+                   :hl, :uint16,
+                   :ix, :uint16,
+                   :iy, :uint16,
+                   :af_, :uint16,
+                   :bc_, :uint16,
+                   :de_, :uint16,
+                   :hl_, :uint16,
+                   :i, :uint8,
+                   :r, :uint8,
+                   :iff1, :uint8,
+                   :iff2, :uint8,
+                   :im, :uint8,
+                   :halted, :uint8
+        end
+
+        # Mapping of the names used by Instance#cpu_state to the fields of StateStruct.
+        STATE_FIELDS = {
+            "PC" => :pc, "SP" => :sp,
+            "AF" => :af, "BC" => :bc, "DE" => :de, "HL" => :hl, "IX" => :ix, "IY" => :iy,
+            "AF'" => :af_, "BC'" => :bc_, "DE'" => :de_, "HL'" => :hl_,
+            "I" => :i, "R" => :r, "IFF1" => :iff1, "IFF2" => :iff2, "IM" => :im
         }
 
         # States that the emulated machine can be in.
@@ -48,25 +98,49 @@ module Zemu
             # Hit a breakpoint in the previous cycle.
             BREAK = 2
 
+            # Execution was interrupted.
+            INTERRUPTED = 3
+
+            # Hit a read, write or access breakpoint in the previous instruction.
+            WATCHPOINT = 4
+
+            # Reached the target of a step over, step out, run to or run until output.
+            REACHED = 5
+
+            # Exceeded a limit set by Instance#watchdog.
+            TIMEOUT = 6
+
             # Undefined. Emulated machine has not yet reached a well-defined state.
             UNDEFINED = -1
         end
 
-        def initialize(configuration)
+        # Constructor.
+        #
+        # @param [Zemu::Config] configuration The configuration of the emulator.
+        # @param [String] library The path of the library to be loaded. Defaults to the
+        #                         library built for the configuration.
+        def initialize(configuration, library=configuration.library)
             @clock = configuration.clock_speed
             @serial_delay = configuration.serial_delay
+            @cpus = configuration.cpus.map(&:name)
 
-            @wrapper = make_wrapper(configuration)
+            @wrapper = Instance.wrapper(configuration, library)
 
             @serial = []
+            @links = {}
+            @watchdog = [0, 0, 0]
+
+            @serial_ports = configuration.io.select { |d| d.is_a?(Config::SerialPort) }.map { |d| d.name.to_s }
+            @memory_blocks = configuration.memory.map { |m| [m.name.to_s, m.address, m.size] }
+
+            @framebuffers = configuration.io.select { |d| d.is_a?(Config::Framebuffer) }.map { |d| [d.name.to_s, d] }.to_h
+            @frames = {}
 
             @instance = @wrapper.zemu_init
             @wrapper.zemu_power_on(@instance)
             @wrapper.zemu_reset(@instance)
 
             @state = RunState::UNDEFINED
-
-            @breakpoints = {}
         end
 
         # Returns the clock speed of this instance in Hz.
@@ -85,24 +159,210 @@ module Zemu
         #
         # 16-bit general-purpose registers must be accessed by their 8-bit
         # component registers.
-        def registers
+        #
+        # @param cpu The name or index of the CPU whose registers are returned,
+        #            or nil for the primary CPU.
+        #
+        # @raise [ArgumentError] Raised if the CPU is unknown.
+        def registers(cpu=nil)
             r = {}
 
+            instance = cpu_instance(cpu)
+
             REGISTERS.each do |reg, num|
-                r[reg] = @wrapper.zemu_debug_register(@instance, num)
+                r[reg] = @wrapper.zemu_debug_register(instance, num)
             end
             
             return r
         end
 
+        # Set the value of a register.
+        #
+        # @param name The name of the register, as in REGISTERS, or a register pair such as "HL".
+        # @param value The value to which the register is set.
+        #
+        # @raise [ArgumentError] Raised if the register is unknown.
+        def set_register(name, value)
+            name = name.to_s.upcase
+
+            if REGISTER_PAIRS.include?(name)
+                set_register(name[0] + name[2..-1].to_s, value >> 8)
+                set_register(name[1..-1], value & 0xff)
+            elsif REGISTERS.key?(name)
+                @wrapper.zemu_debug_set_register(@instance, REGISTERS[name], value)
+            else
+                raise ArgumentError, "Unknown register: #{name}"
+            end
+        end
+
+        # Returns the full state of the CPU, as a hash of the 16-bit registers
+        # (PC, SP, AF, BC, DE, HL, IX, IY and the alternates), I, R, IFF1, IFF2, IM
+        # and "halted", read in one call.
+        def cpu_state
+            state = StateStruct.new
+            @wrapper.zemu_debug_get_state(@instance, state)
+
+            result = {}
+            STATE_FIELDS.each { |name, field| result[name] = state[field] }
+            result["halted"] = (state[:halted] != 0)
+
+            return result
+        end
+
+        # Sets the state of the CPU in one call, from a hash as returned by Instance#cpu_state.
+        # Any values not given are left unchanged. Setting "halted" to false clears the halt
+        # latch, so that execution can continue after a HALT.
+        #
+        # @raise [ArgumentError] Raised if a name is unknown.
+        def cpu_state=(values)
+            state = StateStruct.new
+            @wrapper.zemu_debug_get_state(@instance, state)
+
+            halted = nil
+
+            values.each do |name, value|
+                name = name.to_s
+                if name == "halted"
+                    halted = value
+                    state[:halted] = value ? 1 : 0
+                elsif STATE_FIELDS.key?(name.upcase)
+                    state[STATE_FIELDS[name.upcase]] = value
+                else
+                    raise ArgumentError, "Unknown register: #{name}"
+                end
+            end
+
+            @wrapper.zemu_debug_set_state(@instance, state)
+
+            @state = halted ? RunState::HALTED : RunState::UNDEFINED unless halted.nil?
+        end
+
+        # A snapshot of the state of an emulated machine, as taken by Instance#snapshot.
+        #
+        # * +cpu_states+ - The state of each CPU, as returned by Instance#cpu_state.
+        # * +memory+ - The contents of every writable memory block, as a binary string.
+        Snapshot = Struct.new(:cpu_states, :memory)
+
+        # Take a snapshot of the state of the CPUs and writable memory of this instance.
+        # The state of IO devices is not included.
+        #
+        # The snapshot can be restored to this instance, or to any other instance
+        # with the same configuration.
+        def snapshot
+            states = Array.new(@cpus.size) do |i|
+                state = StateStruct.new
+                @wrapper.zemu_debug_get_state(cpu_instance(i), state)
+                STATE_FIELDS.map { |name, field| [name, state[field]] }.to_h.merge("halted" => state[:halted] != 0)
+            end
+
+            buffer = FFI::MemoryPointer.new(:uint8, [@wrapper.zemu_memory_snapshot_size, 1].max)
+            @wrapper.zemu_memory_save(buffer)
+
+            return Snapshot.new(states.freeze, buffer.read_bytes(@wrapper.zemu_memory_snapshot_size).freeze).freeze
+        end
+
+        # Restore a snapshot taken by Instance#snapshot.
+        #
+        # @param snapshot The snapshot to restore.
+        def restore(snapshot)
+            raise RuntimeError, "The instance is running in the background." if @wrapper.zemu_async_running()
+
+            if snapshot.memory.bytesize != @wrapper.zemu_memory_snapshot_size || snapshot.cpu_states.size != @cpus.size
+                raise ArgumentError, "The snapshot was taken from an instance with a different configuration."
+            end
+
+            @wrapper.zemu_memory_restore(snapshot.memory)
+
+            snapshot.cpu_states.each_with_index do |values, i|
+                state = StateStruct.new
+                STATE_FIELDS.each { |name, field| state[field] = values[name] }
+                state[:halted] = values["halted"] ? 1 : 0
+
+                @wrapper.zemu_debug_set_state(cpu_instance(i), state)
+            end
+
+            @state = snapshot.cpu_states.first["halted"] ? RunState::HALTED : RunState::UNDEFINED
+        end
+
+        # Remove all breakpoints, watchpoints and watchdog limits from this instance.
+        def clear_breakpoints
+            @wrapper.zemu_debug_clear(@instance)
+            @watchdog = [0, 0, 0]
+        end
+
+        # Sets or clears the halt latch. Clearing it lets execution continue after a HALT.
+        def halted=(value)
+            @wrapper.zemu_debug_set_halted(@instance, value)
+            @state = value ? RunState::HALTED : RunState::UNDEFINED
+        end
+
         # Access the value in memory at a given address.
         #
         # @param address The address in memory to be accessed.
+        # @param cpu The name or index of the CPU from whose point of view memory is accessed,
+        #            or nil for the primary CPU.
         #
         # Returns 0 if the memory address is not mapped, otherwise
         # returns the value in the given memory location.
-        def memory(address)
-            return @wrapper.zemu_debug_get_memory(address)
+        #
+        # @raise [ArgumentError] Raised if the CPU is unknown.
+        def memory(address, cpu=nil)
+            return @wrapper.zemu_debug_get_memory(address) if cpu.nil?
+            return @wrapper.zemu_memory_peek_cpu(cpu_index(cpu), address)
+        end
+
+        # Returns the counts of reads, writes and opcode fetches of each page of memory
+        # since this instance started, or since Instance#clear_heatmap, as a Zemu::Heatmap.
+        #
+        # The count of fetches is an approximation. The CPU core makes every read through the
+        # same callback, so a read at the address in PC is counted as a fetch, and any other
+        # read as a data read. The first byte of each instruction is therefore a fetch, but its
+        # prefix and operand bytes are data reads, and a data read which happens to be at the
+        # address in PC, such as LD A,(HL) with HL equal to PC, is a fetch.
+        #
+        # @raise [RuntimeError] Raised if the library was not built with the +heatmap+ parameter set.
+        def heatmap
+            buffer = FFI::MemoryPointer.new(:uint64, 3 * Heatmap::PAGES)
+
+            unless @wrapper.zemu_memory_heatmap(buffer)
+                raise RuntimeError, "The library was not built with the heatmap parameter set."
+            end
+
+            reads, writes, fetches = buffer.read_array_of_uint64(3 * Heatmap::PAGES).each_slice(Heatmap::PAGES).to_a
+
+            return Heatmap.new(reads, writes, fetches, @memory_blocks)
+        end
+
+        # Resets the counts of the heatmap.
+        def clear_heatmap
+            @wrapper.zemu_memory_heatmap_clear
+        end
+
+        # Returns the names of the CPUs of this instance, the first being the primary CPU.
+        def cpus
+            return @cpus.dup
+        end
+
+        # Disassemble a number of consecutive instructions.
+        #
+        # @param address The address of the first instruction.
+        # @param count The number of instructions to disassemble.
+        #
+        # Returns an array of Zemu::Debug::Instruction objects.
+        # Instructions are decoded natively, and cached until the memory they occupy is written.
+        def disassemble(address, count=1)
+            buffer = FFI::MemoryPointer.new(InstructionStruct, count)
+
+            @wrapper.zemu_disassemble(address, count, buffer)
+
+            return Array.new(count) do |i|
+                s = InstructionStruct.new(buffer + (i * InstructionStruct.size))
+
+                target = (s[:flags] & 0x80).zero? ? nil : s[:target]
+
+                Debug::Instruction.new(s[:address], s[:length], s[:mnemonic].to_s, s[:operands].to_s,
+                                       s[:cycles], s[:cycles_taken], target, s[:flags])
+            end
         end
 
         # Write a string to the serial line of the emulated CPU.
@@ -142,39 +402,363 @@ module Zemu
             return return_string
         end
 
+        # Empties the send and receive buffers of every serial port, discarding
+        # any bytes which have not yet been read by either side.
+        def clear_serial
+            @serial_ports.each { |port| @wrapper.send("zemu_io_#{port}_feed", nil, 0) }
+        end
+
+        # Get the current frame of a framebuffer device.
+        #
+        # Only the rows of the framebuffer written since the last frame are rendered, natively.
+        # If nothing has been written, no rendering takes place and the previous frame is returned.
+        #
+        # @param name The name of the framebuffer device.
+        #
+        # Returns a Zemu::Frame for a framebuffer in bitmap mode, or for a framebuffer in text mode,
+        # a string with a line for each row. Characters which are not printable ASCII are shown as spaces.
+        #
+        # @raise [ArgumentError] Raised if the framebuffer is unknown.
+        def frame(name)
+            name = name.to_s
+            device = @framebuffers[name]
+            raise ArgumentError, "Unknown framebuffer: #{name}" if device.nil?
+
+            return @frames[name] if @frames.key?(name) && !@wrapper.send("zemu_io_#{name}_dirty")
+
+            size = device.width * device.height * (device.bitmap? ? 4 : 1)
+            buffer = FFI::MemoryPointer.new(:uint8, size)
+
+            @wrapper.send("zemu_io_#{name}_render", buffer)
+
+            contents = buffer.read_bytes(size)
+
+            @frames[name] = if device.bitmap?
+                Frame.new(device.width, device.height, contents)
+            else
+                contents.tr("^\x20-\x7e".b, " ").scan(/.{#{device.width}}/m).join("\n").freeze
+            end
+        end
+
+        # Link a serial port of this instance to a serial port of another instance.
+        #
+        # Bytes sent by each machine are delivered natively to the other after +latency+ cycles,
+        # rather than to the serial buffers of the host. Linked instances should be run concurrently,
+        # on separate threads or with #start_async: neither runs more than +latency+ cycles ahead
+        # of the other, so that delivery is deterministic. An instance which has halted or quit
+        # no longer holds up the instances linked to it.
+        #
+        # Linked instances must be built from different libraries, as instances of the same library
+        # share their state. A serial port may be linked to another serial port of the same instance.
+        #
+        # @param port The name of the serial port of this instance.
+        # @param other The instance to link to.
+        # @param other_port The name of the serial port of the other instance.
+        # @param latency The number of cycles between a byte being sent and it being delivered.
+        #
+        # @raise [ArgumentError] Raised if either serial port is unknown, the latency is not positive,
+        #                        or the instances share a library.
+        def link_serial(port, other, other_port, latency: 100)
+            raise ArgumentError, "The latency of a serial link must be positive." if latency < 1
+
+            if !other.equal?(self) && other.wrapper.equal?(@wrapper)
+                raise ArgumentError, "Linked instances must be built from different libraries."
+            end
+
+            [[self, port], [other, other_port]].each do |instance, name|
+                unless instance.wrapper.respond_to?("zemu_io_#{name}_link")
+                    raise ArgumentError, "Unknown serial port: #{name}"
+                end
+            end
+
+            link = FFI::MemoryPointer.new(@wrapper.zemu_link_size)
+            @wrapper.zemu_link_init(link, latency)
+
+            attach_link(port, link, 0)
+            other.attach_link(other_port, link, 1)
+        end
+
+        # Number of counters in the map returned by Instance#coverage.
+        COVERAGE_MAP_SIZE = 0x10000
+
+        # Prepare to fuzz the program through a serial port, from the current state of this instance.
+        #
+        # The state of the CPUs and writable memory is snapshotted natively, and restored before
+        # each input given to Instance#fuzz. While fuzzing, runs record the edges between the
+        # instructions executed in a native hit map.
+        #
+        # @param port The name of the serial port to which inputs are fed.
+        # @param cycles The maximum number of cycles for which each input runs, or -1 for no limit.
+        #
+        # @raise [ArgumentError] Raised if there is no serial port with the given name.
+        def fuzz_setup(port, cycles: 1_000_000)
+            unless @wrapper.respond_to?("zemu_io_#{port}_link") && @wrapper.zemu_fuzz_setup(port.to_s, cycles)
+                raise ArgumentError, "Unknown serial port: #{port}"
+            end
+        end
+
+        # Run one input from the snapshot taken by Instance#fuzz_setup.
+        # The input is read by the program from the serial port as it consumes it.
+        #
+        # Breakpoints, watchpoints and watchdog limits apply, so a breakpoint on an
+        # error handler can be used to detect a fault.
+        #
+        # @param input A string of bytes to be fed to the serial port.
+        #
+        # Returns the number of distinct edges executed.
+        def fuzz(input)
+            configure_run(nil, false, false)
+
+            @wrapper.zemu_fuzz_one(@instance, input, input.bytesize)
+            @state = @wrapper.zemu_debug_state()
+
+            return @wrapper.zemu_fuzz_edges
+        end
+
+        # Returns the hit map of the last input run by Instance#fuzz, as a string of
+        # COVERAGE_MAP_SIZE 8-bit counters, indexed as in AFL by the address of an
+        # instruction XORed with half the address of the instruction executed before it.
+        def coverage
+            buffer = FFI::MemoryPointer.new(:uint8, COVERAGE_MAP_SIZE)
+            @wrapper.zemu_fuzz_coverage(buffer)
+
+            return buffer.read_bytes(COVERAGE_MAP_SIZE)
+        end
+
+        # Stop fuzzing, and free the snapshot taken by Instance#fuzz_setup.
+        def fuzz_end
+            @wrapper.zemu_fuzz_end
+        end
+
         # Continue running this instance until either:
         # * A HALT instruction is executed
         # * A breakpoint is hit
         # * The number of cycles given has been executed
+        # * Execution is interrupted (only if +interruptible+ is true)
+        #
+        # Execution takes place natively, without returning to Ruby
+        # until one of the above occurs.
+        #
+        # @param run_cycles The number of cycles to execute, or -1 for no limit.
+        # @param serial An IO object with which to bridge the serial port of the emulated machine,
+        #               with a delay of +serial_delay+ between characters, or nil.
+        # @param realtime If true, execution is paced to the clock speed of this instance.
+        # @param interruptible If true, execution is interrupted by SIGINT (Ctrl-C).
         #
         # Returns the number of cycles executed.
-        def continue(run_cycles=-1)
+        def continue(run_cycles=-1, serial: nil, realtime: false, interruptible: false)
             # Return immediately if we're HALTED.
-            return if @state == RunState::HALTED
+            return 0 if @state == RunState::HALTED
+
+            configure_run(serial, realtime, interruptible)
+
+            cycles_executed = @wrapper.zemu_debug_continue(@instance, run_cycles)
+
+            @state = @wrapper.zemu_debug_state()
+
+            return cycles_executed
+        end
+
+        # Execute a single instruction, or if it is a CALL, RST, DJNZ or repeating block
+        # instruction (e.g. LDIR), run until the instruction following it is reached.
+        # Breakpoints and HALT still stop execution.
+        #
+        # @param run_cycles The maximum number of cycles to execute, or -1 for no limit.
+        # @param serial See Instance#continue.
+        # @param realtime See Instance#continue.
+        # @param interruptible See Instance#continue.
+        #
+        # Returns the number of cycles executed.
+        def step_over(run_cycles=-1, serial: nil, realtime: false, interruptible: false)
+            return 0 if @state == RunState::HALTED
+
+            configure_run(serial, realtime, interruptible)
+
+            cycles_executed = @wrapper.zemu_debug_step_over(@instance, run_cycles)
+            @state = @wrapper.zemu_debug_state()
+
+            return cycles_executed
+        end
+
+        # Run until a return instruction leaves the current stack frame, i.e. until SP
+        # rises above its current value with a RET. Breakpoints and HALT still stop execution.
+        #
+        # @param run_cycles The maximum number of cycles to execute, or -1 for no limit.
+        # @param serial See Instance#continue.
+        # @param realtime See Instance#continue.
+        # @param interruptible See Instance#continue.
+        #
+        # Returns the number of cycles executed.
+        def step_out(run_cycles=-1, serial: nil, realtime: false, interruptible: false)
+            return 0 if @state == RunState::HALTED
+
+            configure_run(serial, realtime, interruptible)
 
-            cycles_executed = 0
+            cycles_executed = @wrapper.zemu_debug_step_out(@instance, run_cycles)
+            @state = @wrapper.zemu_debug_state()
+
+            return cycles_executed
+        end
+
+        # Run until the program counter reaches the given address or symbol.
+        # Breakpoints and HALT still stop execution.
+        #
+        # @param target The address to run to, or the label of a symbol in +symbols+.
+        # @param run_cycles The maximum number of cycles to execute, or -1 for no limit.
+        # @param symbols A Debug::SymbolTable in which to look up the label given.
+        # @param serial See Instance#continue.
+        # @param realtime See Instance#continue.
+        # @param interruptible See Instance#continue.
+        #
+        # Returns the number of cycles executed.
+        #
+        # @raise [ArgumentError] Raised if the label is not in the symbol table.
+        def run_to(target, run_cycles=-1, symbols: nil, serial: nil, realtime: false, interruptible: false)
+            address = resolve(target, symbols)
+
+            return 0 if @state == RunState::HALTED
+
+            configure_run(serial, realtime, interruptible)
+
+            cycles_executed = @wrapper.zemu_debug_run_to(@instance, address, run_cycles)
+            @state = @wrapper.zemu_debug_state()
+
+            return cycles_executed
+        end
+
+        # Call an emulated function, as a unit-test primitive.
+        #
+        # Sets the given registers, pushes the stack arguments and a sentinel return address,
+        # and runs natively until the function returns to the sentinel. The arguments are
+        # then popped, as by the caller. The stack must be in RAM.
+        #
+        # @example
+        #   registers, cycles = instance.call("multiply", registers: { "HL" => 12, "DE" => 34 })
+        #   assert_equal 408, (registers["H"] << 8) | registers["L"]
+        #
+        # @param target The address of the function, or the label of a symbol in +symbols+.
+        # @param registers A hash of register names (as in REGISTERS, or a pair such as "HL") to values.
+        # @param stack_args 16-bit values to push, so that the first is nearest the return address.
+        # @param max_cycles The maximum number of cycles to execute, or -1 for no limit.
+        # @param symbols A Debug::SymbolTable in which to look up the label given.
+        # @param sentinel The return address from which the function is called. Execution
+        #                 stops when it returns here with the same stack depth.
+        #
+        # Returns the registers (as from Instance#registers) and the number of cycles executed.
+        #
+        # @raise [ArgumentError] Raised if the symbol or a register is unknown.
+        # @raise [RuntimeError] Raised if the function does not return, due to a breakpoint,
+        #                       HALT or the cycle limit. The instance is left in that state.
+        def call(target, registers: {}, stack_args: [], max_cycles: -1, symbols: nil, sentinel: 0xFFFF)
+            address = resolve(target, symbols)
+
+            registers.each { |name, value| set_register(name, value) }
+
+            configure_run(nil, false, false)
+
+            args = stack_args.pack("S*")
+            cycles_executed = @wrapper.zemu_debug_call(@instance, address, args, stack_args.size, sentinel, max_cycles)
+            @state = @wrapper.zemu_debug_state()
+
+            unless reached?
+                raise RuntimeError, "Call to 0x%04x did not return (PC = 0x%04x)." % [address, @wrapper.zemu_debug_pc(@instance)]
+            end
+
+            return self.registers, cycles_executed
+        end
+
+        # Run until the given pattern appears in the serial output of the emulated machine,
+        # stopping as soon as its last byte is written. Breakpoints and HALT still stop execution.
+        #
+        # The output remains in the serial buffer, to be read with Instance#serial_gets.
+        #
+        # @param pattern The String to wait for.
+        # @param timeout_cycles The maximum number of cycles to execute, or -1 for no limit.
+        #
+        # Returns true if the pattern appeared, false otherwise.
+        #
+        # @raise [ArgumentError] Raised if the pattern is empty or too long.
+        def run_until_output(pattern, timeout_cycles: -1)
+            pattern = pattern.to_s.b
+            raise ArgumentError, "Pattern must be between 1 and 256 bytes long." if pattern.empty? || pattern.bytesize > 256
+
+            return false if @state == RunState::HALTED
+
+            configure_run(nil, false, false)
+
+            @wrapper.zemu_debug_run_until_output(@instance, pattern, pattern.bytesize, timeout_cycles)
+            @state = @wrapper.zemu_debug_state()
+
+            return reached?
+        end
+
+        # Returns true if the target of a step_over, step_out, run_to or run_until_output was reached, false otherwise.
+        def reached?
+            return @state == RunState::REACHED
+        end
+
+        # Start running this instance in a native background thread, as Instance#continue,
+        # and return immediately.
+        #
+        # While it runs, only the serial methods (from one Ruby thread at a time), Instance#cycles,
+        # Instance#running?, Instance#pause and Instance#wait may be used.
+        #
+        # @param run_cycles The number of cycles to execute, or -1 for no limit.
+        # @param serial See Instance#continue.
+        # @param realtime See Instance#continue.
+        #
+        # Returns Instance#events, which becomes readable when the run stops.
+        #
+        # @raise [RuntimeError] Raised if the instance is already running, or the thread cannot be started.
+        def start_async(run_cycles=-1, serial: nil, realtime: false)
+            configure_run(serial, realtime, false)
+
+            raise RuntimeError, "Could not start a background thread." unless @wrapper.zemu_async_start(@instance, run_cycles)
 
             @state = RunState::RUNNING
 
-            # Run as long as:
-            #   We haven't hit a breakpoint
-            #   We haven't halted
-            #   We haven't hit the number of cycles we've been told to execute for.
-            while (run_cycles == -1 || cycles_executed < run_cycles) && (@state == RunState::RUNNING)
-                cycles_executed += @wrapper.zemu_debug_step(@instance)
-
-                pc = @wrapper.zemu_debug_pc(@instance)
-
-                # If the PC is now pointing to one of our breakpoints,
-                # we're in the BREAK state.
-                if @breakpoints[pc]
-                    @state = RunState::BREAK
-                elsif @wrapper.zemu_debug_halted()
-                    @state = RunState::HALTED
-                end
+            return events
+        end
+
+        # Returns true if this instance is running in the background, false otherwise.
+        def running?
+            return @wrapper.zemu_async_running()
+        end
+
+        # Request that a background run stops. This returns immediately, and the
+        # run stops (as Instance#interrupted?) within a few thousand cycles.
+        # Use Instance#wait or Instance#events to find out when it has stopped.
+        def pause
+            @wrapper.zemu_async_pause()
+        end
+
+        # Wait for a background run to stop.
+        #
+        # @param timeout The maximum time to wait in seconds, or nil to wait indefinitely.
+        #
+        # Returns true if the run has stopped (or none was started), false if the timeout expired.
+        # Once stopped, Instance#halted?, Instance#break? etc. give the reason.
+        def wait(timeout=nil)
+            timeout_ms = timeout.nil? ? -1 : (timeout * 1000).to_i
+
+            return false unless @wrapper.zemu_async_wait(timeout_ms)
+
+            # Consume the stop events, so that Instance#events is not readable until the next stop.
+            loop do
+                data = events.read_nonblock(64, exception: false)
+                break if data.nil? || data == :wait_readable
             end
 
-            return cycles_executed
+            @state = @wrapper.zemu_debug_state()
+
+            return true
+        end
+
+        # Returns an IO which becomes readable whenever a background run stops,
+        # for use with IO.select or a Fiber scheduler. Call Instance#wait once it is readable.
+        def events
+            @events ||= IO.for_fd(@wrapper.zemu_async_fd(), autoclose: false)
+            return @events
         end
 
         # Set a breakpoint of the given type at the given address.
@@ -182,8 +766,40 @@ module Zemu
         # @param address The address of the breakpoint
         # @param type The type of breakpoint:
         #   * :program => Break when the program counter hits the address given. 
-        def break(address, type)
-            @breakpoints[address] = true
+        #   * :read => Break after an instruction reads memory at the address given.
+        #   * :write => Break after an instruction writes memory at the address given.
+        #   * :access => Break after an instruction reads or writes memory at the address given.
+        # @param condition A condition for a :program breakpoint, as a String or Debug::Condition.
+        #                  The condition is evaluated natively whenever the breakpoint is hit,
+        #                  and execution only stops if it is true. See Debug::Condition.
+        #
+        # @raise [ArgumentError] Raised if the condition is invalid, or there are too many conditional breakpoints.
+        def break(address, type, condition: nil)
+            unless condition.nil?
+                raise ArgumentError, "Only :program breakpoints can have conditions." unless type == :program
+
+                condition = Debug::Condition.new(condition) unless condition.is_a?(Debug::Condition)
+
+                unless @wrapper.zemu_debug_set_condition(address, condition.bytecode, condition.bytecode.bytesize)
+                    raise ArgumentError, "Too many conditional breakpoints."
+                end
+            end
+
+            @wrapper.zemu_debug_set_condition(address, nil, 0) if condition.nil? && type == :program
+
+            set_break(address, type, true)
+        end
+
+        # Returns the number of times the conditional breakpoint at the given address has been hit,
+        # whether or not its condition was true.
+        def hits(address)
+            return @wrapper.zemu_debug_hits(address)
+        end
+
+        # Returns the number of cycles executed since this instance was started.
+        # While running in the background, this is updated every few thousand cycles.
+        def cycles
+            return @wrapper.zemu_debug_cycles()
         end
 
         # Remove a breakpoint of the given type at the given address.
@@ -192,7 +808,35 @@ module Zemu
         # @param address The address of the breakpoint to be removed.
         # @param type The type of breakpoint. See Instance#break.
         def remove_break(address, type)
-            @breakpoints[address] = false
+            @wrapper.zemu_debug_set_condition(address, nil, 0) if type == :program
+
+            set_break(address, type, false)
+        end
+
+        # Serve GDB remote serial protocol requests, so that a debugger such as gdb
+        # can control this instance. Waits for a debugger to connect, and returns once
+        # it detaches. Execution and memory access take place natively.
+        #
+        # @param address Where to listen for the debugger. Either a TCP port as "<port>"
+        #                or "<host>:<port>" (localhost if the host is omitted), or the path
+        #                of a Unix socket.
+        #
+        # Returns the reason for returning: :detached, :killed or :disconnected.
+        #
+        # @raise [IOError] Raised if the address cannot be listened on.
+        def gdb_serve(address)
+            configure_run(nil, false, false)
+
+            # The debugger controls how long the instance runs for.
+            @wrapper.zemu_debug_set_watchdog(0, 0, 0)
+
+            result = @wrapper.zemu_gdb_serve(@instance, address.to_s)
+
+            raise IOError, "Could not serve GDB requests at '#{address}'." if result < 0
+
+            @state = @wrapper.zemu_debug_state()
+
+            return [:detached, :killed, :disconnected][result]
         end
 
         # Returns true if the CPU has halted, false otherwise.
@@ -202,22 +846,192 @@ module Zemu
 
         # Returns true if a breakpoint has been hit, false otherwise.
         def break?
-            return @state == RunState::BREAK
+            return @state == RunState::BREAK || @state == RunState::WATCHPOINT
+        end
+
+        # Returns true if execution was interrupted, false otherwise.
+        def interrupted?
+            return @state == RunState::INTERRUPTED
+        end
+
+        # Returns true if execution exceeded a limit set by Instance#watchdog, false otherwise.
+        def timed_out?
+            return @state == RunState::TIMEOUT
+        end
+
+        # Returns the value of PC when the last run of this instance stopped,
+        # for whatever reason.
+        def stop_pc
+            return @wrapper.zemu_debug_stop_pc()
+        end
+
+        # Limit each subsequent run of this instance, so that a runaway program cannot
+        # run indefinitely. A run which exceeds any limit stops, and Instance#timed_out?
+        # becomes true. Limits are checked natively every few thousand cycles,
+        # so a run may slightly exceed them.
+        #
+        # Limits apply to Instance#continue, Instance#step_over, Instance#step_out,
+        # Instance#run_to, Instance#call, Instance#run_until_output and Instance#start_async,
+        # but not to a debugger connected with Instance#gdb_serve.
+        #
+        # @param cycles The maximum number of cycles of each run, or nil for no limit.
+        # @param instructions The maximum number of instructions of each run, or nil for no limit.
+        # @param seconds The maximum host time of each run in seconds, or nil for no limit.
+        #
+        # @example
+        #
+        #   instance.watchdog(seconds: 5)
+        #   instance.continue
+        #   raise "Timed out at 0x%04x" % instance.stop_pc if instance.timed_out?
+        def watchdog(cycles: nil, instructions: nil, seconds: nil)
+            @watchdog = [cycles.to_i, instructions.to_i, (seconds.to_f * 1_000_000_000).to_i]
         end
 
         # Powers off the emulated CPU and destroys this instance.
         def quit
+            if running?
+                pause
+                wait
+            end
+
+            # Detach serial links, which may outlive this instance.
+            @links.each_key { |port| @wrapper.send("zemu_io_#{port}_link", nil, 0) }
+            @links.clear
+
             @wrapper.zemu_power_off(@instance)
             @wrapper.zemu_free(@instance)
         end
 
-        # Creates a wrapper around the Zemu module built with the given configuration.
-        def make_wrapper(configuration)
+        # The wrapper around the library of this instance.
+        attr_reader :wrapper
+
+        protected :wrapper
+
+        # Attaches one side of a serial link to the given serial port.
+        def attach_link(port, link, side)
+            raise RuntimeError, "The instance is running in the background." if @wrapper.zemu_async_running()
+            raise RuntimeError, "Too many serial links." unless @wrapper.send("zemu_io_#{port}_link", link, side)
+
+            # Keep the memory of the link alive while it is in use.
+            @links[port.to_s] = link
+        end
+
+        protected :attach_link
+
+        # Register pairs, which are written as two 8-bit registers.
+        REGISTER_PAIRS = %w(AF BC DE HL AF' BC' DE' HL')
+
+        # Returns the address of the given target, which is either an address
+        # or the label of a symbol in the given symbol table.
+        def resolve(target, symbols)
+            return target if target.is_a?(Integer)
+
+            address = symbols.address_of(target.to_s) unless symbols.nil?
+            raise ArgumentError, "Unknown symbol: #{target}" unless address.is_a?(Integer)
+
+            return address
+        end
+
+        private :resolve
+
+        # Returns the index of the given CPU, which is either an index or the name of a CPU.
+        def cpu_index(cpu)
+            index = cpu.is_a?(Integer) ? cpu : @cpus.index(cpu.to_s)
+            raise ArgumentError, "Unknown CPU: #{cpu}" unless !index.nil? && index >= 0 && index < @cpus.size
+
+            return index
+        end
+
+        private :cpu_index
+
+        # Returns the native Z80 instance of the given CPU, or of the primary CPU if nil.
+        def cpu_instance(cpu)
+            return @instance if cpu.nil?
+            return @wrapper.zemu_cpu(cpu_index(cpu))
+        end
+
+        private :cpu_instance
+
+        # Sets how the native run loop paces execution, bridges serial IO and handles SIGINT.
+        def configure_run(serial, realtime, interruptible)
+            raise RuntimeError, "The instance is running in the background." if @wrapper.zemu_async_running()
+
+            @wrapper.zemu_debug_set_pacing(realtime ? @clock : 0)
+            @wrapper.zemu_debug_set_bridge(serial.nil? ? -1 : serial.fileno, (@serial_delay * @clock).to_i)
+            @wrapper.zemu_debug_set_interruptible(interruptible)
+            @wrapper.zemu_debug_set_watchdog(*@watchdog)
+        end
+
+        private :configure_run
+
+        # Types of memory access for read, write and access breakpoints.
+        WATCH_TYPES = { read: 0x01, write: 0x02, access: 0x03 }
+
+        # Sets or clears a breakpoint of the given type at the given address.
+        def set_break(address, type, set)
+            if type == :program
+                @wrapper.zemu_debug_set_breakpoint(address, set)
+            elsif WATCH_TYPES.key?(type)
+                @wrapper.zemu_debug_set_watchpoint(@instance, address, WATCH_TYPES[type], set)
+            else
+                raise ArgumentError, "Invalid breakpoint type: #{type}"
+            end
+        end
+
+        private :set_break
+
+        # Wrappers around loaded libraries, keyed by library path and file identity.
+        @wrappers = {}
+        @wrappers_lock = Mutex.new
+
+        # Paths of the libraries which have been loaded, and the number of reloads.
+        @loaded = {}
+        @reloads = 0
+
+        # Returns a wrapper around the Zemu library built with the given configuration.
+        #
+        # Wrappers are created once for each library and shared between instances,
+        # so that the library is loaded and its functions attached only once.
+        #
+        # A library which has been rebuilt since it was last loaded gets a new wrapper.
+        # As loading a path which is already loaded returns the library loaded before,
+        # the rebuilt library is loaded from a temporary copy.
+        #
+        # @param [Zemu::Config] configuration The configuration with which the library was built.
+        # @param [String] library The path of the library.
+        def self.wrapper(configuration, library)
+            path = File.expand_path(library)
+            stat = File.stat(path)
+            key = [path, stat.ino, stat.mtime, stat.size]
+
+            @wrappers_lock.synchronize do
+                @wrappers[key] ||= begin
+                    if @loaded.key?(path)
+                        @reloads += 1
+                        copy = "#{path}.#{Process.pid}.#{@reloads}"
+                        FileUtils.cp(path, copy)
+
+                        # The copy stays mapped once loaded, so it need not be kept.
+                        begin
+                            make_wrapper(configuration, copy)
+                        ensure
+                            File.delete(copy)
+                        end
+                    else
+                        @loaded[path] = true
+                        make_wrapper(configuration, path)
+                    end
+                end
+            end
+        end
+
+        # Creates a wrapper around the Zemu library built with the given configuration.
+        def self.make_wrapper(configuration, library)
             wrapper = Module.new
 
             wrapper.extend FFI::Library
 
-            wrapper.ffi_lib [File.join(configuration.output_directory, "#{configuration.name}.so")]
+            wrapper.ffi_lib [library]
 
             wrapper.attach_function :zemu_init, [], :pointer
             wrapper.attach_function :zemu_free, [:pointer], :void
@@ -229,13 +1043,69 @@ module Zemu
 
             wrapper.attach_function :zemu_debug_step, [:pointer], :uint64
 
+            wrapper.attach_function :zemu_debug_continue, [:pointer, :int64], :uint64, blocking: true
+            wrapper.attach_function :zemu_debug_state, [], :int32
+            wrapper.attach_function :zemu_debug_stop, [], :void
+
+            wrapper.attach_function :zemu_async_start, [:pointer, :int64], :bool
+            wrapper.attach_function :zemu_async_pause, [], :void
+            wrapper.attach_function :zemu_async_wait, [:int64], :bool, blocking: true
+            wrapper.attach_function :zemu_async_running, [], :bool
+            wrapper.attach_function :zemu_async_fd, [], :int
+
+            wrapper.attach_function :zemu_debug_step_over, [:pointer, :int64], :uint64, blocking: true
+            wrapper.attach_function :zemu_debug_step_out, [:pointer, :int64], :uint64, blocking: true
+            wrapper.attach_function :zemu_debug_run_to, [:pointer, :uint16, :int64], :uint64, blocking: true
+            wrapper.attach_function :zemu_debug_call, [:pointer, :uint16, :buffer_in, :size_t, :uint16, :int64], :uint64, blocking: true
+            wrapper.attach_function :zemu_debug_run_until_output, [:pointer, :buffer_in, :size_t, :int64], :uint64, blocking: true
+
+            wrapper.attach_function :zemu_debug_set_breakpoint, [:uint16, :bool], :void
+            wrapper.attach_function :zemu_debug_set_condition, [:uint16, :buffer_in, :size_t], :bool
+            wrapper.attach_function :zemu_debug_hits, [:uint16], :uint64
+            wrapper.attach_function :zemu_debug_cycles, [], :uint64
+            wrapper.attach_function :zemu_debug_set_watchpoint, [:pointer, :uint16, :uint8, :bool], :void
+
+            wrapper.attach_function :zemu_gdb_serve, [:pointer, :string], :int32, blocking: true
+
+            wrapper.attach_function :zemu_debug_set_pacing, [:uint64], :void
+            wrapper.attach_function :zemu_debug_set_bridge, [:int, :uint64], :void
+            wrapper.attach_function :zemu_debug_set_interruptible, [:bool], :void
+            wrapper.attach_function :zemu_debug_set_watchdog, [:uint64, :uint64, :uint64], :void
+            wrapper.attach_function :zemu_debug_stop_pc, [], :uint16
+
             wrapper.attach_function :zemu_debug_halted, [], :bool
 
             wrapper.attach_function :zemu_debug_register, [:pointer, :uint16], :uint16
+            wrapper.attach_function :zemu_debug_set_register, [:pointer, :uint16, :uint16], :void
+            wrapper.attach_function :zemu_debug_get_state, [:pointer, :pointer], :void
+            wrapper.attach_function :zemu_debug_set_state, [:pointer, :pointer], :void
+            wrapper.attach_function :zemu_debug_set_halted, [:pointer, :bool], :void
             wrapper.attach_function :zemu_debug_pc, [:pointer], :uint16
 
             wrapper.attach_function :zemu_debug_get_memory, [:uint16], :uint8
 
+            wrapper.attach_function :zemu_disassemble, [:uint16, :size_t, :pointer], :size_t
+
+            wrapper.attach_function :zemu_link_size, [], :size_t
+            wrapper.attach_function :zemu_link_init, [:pointer, :uint64], :void
+
+            wrapper.attach_function :zemu_memory_snapshot_size, [], :size_t
+            wrapper.attach_function :zemu_memory_save, [:pointer], :void
+            wrapper.attach_function :zemu_memory_restore, [:buffer_in], :void
+            wrapper.attach_function :zemu_debug_clear, [:pointer], :void
+
+            wrapper.attach_function :zemu_memory_heatmap, [:pointer], :bool
+            wrapper.attach_function :zemu_memory_heatmap_clear, [], :void
+
+            wrapper.attach_function :zemu_fuzz_setup, [:string, :int64], :bool
+            wrapper.attach_function :zemu_fuzz_one, [:pointer, :buffer_in, :size_t], :uint64, blocking: true
+            wrapper.attach_function :zemu_fuzz_edges, [], :size_t
+            wrapper.attach_function :zemu_fuzz_coverage, [:buffer_out], :void
+            wrapper.attach_function :zemu_fuzz_end, [], :void
+
+            wrapper.attach_function :zemu_cpu, [:size_t], :pointer
+            wrapper.attach_function :zemu_memory_peek_cpu, [:size_t, :uint16], :uint8
+
             configuration.io.each do |device|
                 device.functions.each do |f|
                     wrapper.attach_function(f["name"], f["args"], f["return"])
@@ -245,6 +1115,6 @@ module Zemu
             return wrapper
         end
 
-        private :make_wrapper
+        private_class_method :make_wrapper
     end
 end
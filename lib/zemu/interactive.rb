@@ -8,7 +8,7 @@ module Zemu
         def initialize(instance)
             @instance = instance
 
-            @symbol_table = {}
+            @symbol_table = Debug::SymbolTable.new
 
             @master, @slave = PTY.open
             log "Opened PTY at #{@slave.path}"
@@ -46,13 +46,27 @@ module Zemu
                     end
 
                 elsif cmd[0] == "step"
-                    continue(1)
+                    if cmd[1].nil?
+                        continue(1)
+                    else
+                        step(cmd[1])
+                    end
+
+                elsif cmd[0] == "run"
+                    run_to(cmd[1])
 
                 elsif cmd[0] == "registers"
                     registers
 
+                elsif cmd[0] == "set"
+                    set_register(cmd[1], cmd[2])
+
                 elsif cmd[0] == "break"
-                    add_breakpoint(cmd[1])
+                    if cmd[2].nil?
+                        add_breakpoint(cmd[1])
+                    else
+                        add_breakpoint(cmd[1], cmd[2..-1].join(" "))
+                    end
 
                 elsif cmd[0] == "memory"
                     if cmd[2].nil?
@@ -61,18 +75,40 @@ module Zemu
                         memory(cmd[1], cmd[2])
                     end
 
+                elsif cmd[0] == "disassemble"
+                    if cmd[2].nil?
+                        disassemble(cmd[1])
+                    else
+                        disassemble(cmd[1], cmd[2])
+                    end
+
                 elsif cmd[0] == "map"
                     load_map(cmd[1])
 
+                elsif cmd[0] == "gdb"
+                    gdb(cmd[1])
+
                 elsif cmd[0] == "help"
                     log "Available commands:"
                     log "    continue [<n>]     - Continue execution for <n> cycles"
                     log "    step               - Step over a single instruction"
+                    log "    step over          - Step over a single instruction, or run until a CALL, RST, DJNZ"
+                    log "                         or repeating instruction completes"
+                    log "    step out           - Run until the current function returns"
+                    log "    run <a>            - Run until address or symbol <a> is reached"
                     log "    registers          - View register contents"
+                    log "    set <r> <v>        - Set register (or pair) <r> to the hex value <v>"
                     log "    memory <a> [<n>]   - View <n> bytes of memory, starting at address <a>."
                     log "                         <n> defaults to 1 if omitted."
+                    log "    disassemble <a> [<n>]"
+                    log "                       - Disassemble <n> instructions, starting at address <a>."
+                    log "                         <n> defaults to 1 if omitted."
                     log "    map <path>         - Load symbols from map file at <path>"
-                    log "    break  <a>         - Set a breakpoint at the given address <a>."
+                    log "    break  <a> [<c>]   - Set a breakpoint at the given address <a>."
+                    log "                         If a condition <c> is given (e.g. A == 0x42 && (HL) != 0),"
+                    log "                         only break when it is true."
+                    log "    gdb <port>         - Wait for gdb to connect on TCP port (or Unix socket) <port>,"
+                    log "                         and return here when it detaches."
                     log "    quit               - End this emulator instance."
 
                 else
@@ -116,18 +152,11 @@ module Zemu
             log "#{hi}:  #{r(hi)} #{lo}: #{r(lo)} (#{get_symbol(value)})"
         end
 
+        # Returns a string describing the symbol at or nearest before the given address.
         def get_symbol(value)
-            syms = nil
-            addr = value
-            while addr > 0 do
-                syms = @symbol_table[addr]
-                break unless syms.nil?
-                addr -= 1
-            end
+            sym, offset = @symbol_table.lookup(value)
 
-            sym = if syms.nil? then nil else syms[0] end
-
-            sym_str = "<#{if sym.nil? then 'undefined' else sym.label end}#{if addr == value then '' else "+#{value-addr}" end}>"
+            sym_str = "<#{if sym.nil? then 'undefined' else sym.label end}#{if sym.nil? || offset.zero? then '' else "+#{offset}" end}>"
 
             return sym_str
         end
@@ -155,58 +184,92 @@ module Zemu
                 return
             end
 
-            # Continue executing instruction-by-instruction.
-            # Process IO in-between.
-            cycles_left = cycles
-            actual_cycles = 0
+            # Run natively, bridging the serial port to the TTY and pacing
+            # execution to the clock speed. Ctrl-C returns to the prompt.
+            actual_cycles = @instance.continue(cycles, serial: @master, realtime: true, interruptible: true)
 
-            serial_count = @instance.serial_delay.to_f
+            report_stop(actual_cycles)
+        end
 
-            while ((cycles == -1) || (cycles_left > 0))
-                # Get time before execution.
-                start = Time.now
+        # Serve GDB remote serial protocol requests at the given address.
+        def gdb(address)
+            if address.nil?
+                log "No port given."
+                return
+            end
 
-                old_pc = r16("PC")
+            log "Waiting for gdb on #{address}..."
 
-                if (serial_count >= @instance.serial_delay)
-                    process_serial
-                    serial_count = 0.0
-                end
+            begin
+                result = @instance.gdb_serve(address)
+                log "gdb session ended (#{result})."
+            rescue IOError => e
+                log e.message
+            end
+        end
+
+        # Step over or out of the current instruction, as given by the string.
+        def step(type)
+            if type == "over"
+                cycles = @instance.step_over(serial: @master, realtime: true, interruptible: true)
+            elsif type == "out"
+                cycles = @instance.step_out(serial: @master, realtime: true, interruptible: true)
+            else
+                log "Invalid step type: #{type}"
+                return
+            end
+
+            report_stop(cycles)
+        end
 
-                cycles_done = @instance.continue(1)
-                cycles_left -= cycles_done
-                actual_cycles += cycles_done
+        # Run until the PC reaches the address or symbol given by the string.
+        def run_to(target)
+            if target.nil?
+                log "No address given."
+                return
+            end
 
-                # Get time after execution.
-                ending = Time.now
+            # Prefer a symbol, and otherwise treat the target as a hex address.
+            address = @symbol_table.address_of(target) || target.to_i(16)
 
-                # Get elapsed time and calculate padding time to match clock speed.
-                if @instance.clock_speed > 0
-                    elapsed = ending - start
+            report_stop(@instance.run_to(address, serial: @master, realtime: true, interruptible: true))
+        end
 
-                    execution_time = cycles_done * (1.0/@instance.clock_speed)
-                    serial_count += execution_time
-                    
-                    padding = execution_time - elapsed
-                    sleep(padding) unless padding < 0
-                end
+        # Logs why execution stopped, and where.
+        def report_stop(cycles)
+            if @instance.break?
+                log "Hit breakpoint at #{r16("PC")}."
+            elsif @instance.halted?
+                log "Executed HALT instruction."
+            elsif @instance.interrupted?
+                log "Interrupted at #{r16("PC")}."
+            elsif @instance.reached?
+                log "Stopped at #{r16("PC")}."
+            elsif @instance.timed_out?
+                log "Timed out at #{r16("PC")}."
+            end
 
-                # Have we hit a breakpoint or HALT instruction?
-                if @instance.break?
-                    log "Hit breakpoint at #{r16("PC")}."
-                    break
-                elsif @instance.halted?
-                    log "Executed HALT instruction at #{old_pc}."
-                    break
-                end
+            log "Executed for #{cycles} cycles."
+        end
+
+        # Set a register to the hex value given by the string.
+        def set_register(name, value)
+            if name.nil? || value.nil?
+                log "Register and value must be given."
+                return
             end
 
-            log "Executed for #{actual_cycles} cycles."
+            @instance.set_register(name, value.to_i(16))
+        rescue ArgumentError => e
+            log e.message
         end
 
-        # Add a breakpoint at the address given by the string.
-        def add_breakpoint(addr_str)
-            @instance.break(addr_str.to_i(16), :program)
+        # Add a breakpoint at the address given by the string,
+        # with an optional condition.
+        def add_breakpoint(addr_str, condition=nil)
+            @instance.break(addr_str.to_i(16), :program, condition: condition)
+        rescue ArgumentError => e
+            log e.message
         end
 
         # Dump an amount of memory.
@@ -231,6 +294,23 @@ module Zemu
             end
         end
 
+        # Disassemble a number of instructions.
+        def disassemble(address, count="1")
+            if address.nil?
+                log "Expected an address, got #{address}."
+                return
+            end
+
+            @instance.disassemble(address.to_i(16), count.to_i).each do |i|
+                @symbol_table[i.address].each { |sym| log "#{sym.label}:" }
+
+                target = i.target.nil? ? "" : " #{get_symbol(i.target)}"
+
+                log "%04x: %-20s%s" % [i.address, i.to_s, target]
+            end
+        end
+
+        # Load symbols from the map file at the given path.
         def load_map(path)
             if path.nil?
                 log "No path specified."
@@ -247,38 +327,11 @@ module Zemu
                 return
             end
 
-            syms = {}
             begin
-                syms.merge! Debug.load_map(path.to_s)
+                @symbol_table.merge! Debug::SymbolTable.load_map(path.to_s)
             rescue ArgumentError => e
                 log "Error loading map file: #{e.message}"
-                syms.clear
-            end
-
-            @symbol_table.merge! syms
-        end
-
-        # Process serial input/output via the TTY.
-        def process_serial
-            # Read/write serial.
-            # Get the strings to be input/output.
-            input = ""
-            ready = IO.select([@master], [], [], 0)
-            unless ready.nil? || ready.empty?
-                input = @master.read(1)
-            end
-
-            output = @instance.serial_gets(1)
-
-            unless input.empty?
-                @instance.serial_puts input
-                log "Serial in: #{input}"
-            end
-
-            unless output.empty?
-                @master.write output
-                log "Serial out: #{output}"
             end
         end
     end
-end
\ No newline at end of file
+end
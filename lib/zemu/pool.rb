@@ -0,0 +1,157 @@
+require 'fileutils'
+
+module Zemu
+    # A pool of initialized instances of a configuration, which are reused
+    # rather than built and started for each use.
+    #
+    # As the state of an emulator is global to its library, each instance in the pool
+    # loads its own copy of the library, made once when the instance is first needed.
+    # The library is built once for the pool.
+    #
+    # Each instance handed out by the pool is first restored to a snapshot (by default,
+    # the state of the instance just after it was started), and has its breakpoints,
+    # watchpoints and watchdog limits removed. The buffers of its serial ports are emptied,
+    # but the state of other IO devices, such as the contents of framebuffers, is not restored.
+    #
+    # @example
+    #
+    #   pool = Zemu::Pool.new(conf, size: 4)
+    #
+    #   pool.with do |instance|
+    #       instance.continue(1_000_000)
+    #   end
+    #
+    #   pool.shutdown
+    #
+    class Pool
+        # The maximum number of instances in this pool.
+        attr_reader :size
+
+        # Constructor.
+        #
+        # @param [Zemu::Config] configuration The configuration of the instances in the pool.
+        # @param size The maximum number of instances.
+        # @param max_memory The maximum memory in bytes used by the instances, or nil for no limit.
+        #                   Each instance is counted as the size of its library and of its memory blocks.
+        #                   This reduces the size of the pool, but it always has at least one instance.
+        #
+        # @raise [RuntimeError] Raised if the library cannot be built.
+        def initialize(configuration, size: 4, max_memory: nil)
+            @configuration = configuration
+
+            raise RuntimeError, "Could not build the library for #{configuration.name}." unless Zemu.build(configuration)
+
+            unless max_memory.nil?
+                per_instance = File.size(configuration.library) + configuration.memory.sum(&:size)
+                size = [size, max_memory / per_instance].min
+            end
+
+            @size = [size, 1].max
+
+            @idle = []
+            @busy = []
+            @boot = {}
+            @closed = false
+
+            @lock = Mutex.new
+            @available = ConditionVariable.new
+        end
+
+        # Take an instance from the pool, starting a new instance if all are in use
+        # and the pool is not full, or otherwise waiting until one is released.
+        #
+        # @param snapshot The snapshot to which the instance is restored,
+        #                 or nil for the state of the instance just after it was started.
+        #
+        # Returns the instance, which must be given back with Pool#release.
+        #
+        # @raise [RuntimeError] Raised if the pool has been shut down.
+        def checkout(snapshot=nil)
+            instance = @lock.synchronize do
+                @available.wait(@lock) while !@closed && @idle.empty? && @busy.size >= @size
+                raise RuntimeError, "The pool has been shut down." if @closed
+
+                instance = @idle.pop || start(@busy.size + @idle.size)
+                @busy << instance
+                instance
+            end
+
+            instance.clear_breakpoints
+            instance.clear_serial
+            instance.restore(snapshot || @boot[instance])
+
+            return instance
+        end
+
+        # Give an instance back to the pool. An instance running in the background is paused.
+        # If the pool has been shut down, the instance is quit instead.
+        #
+        # @param instance An instance taken from this pool with Pool#checkout.
+        def release(instance)
+            if instance.running?
+                instance.pause
+                instance.wait
+            end
+
+            closed = @lock.synchronize do
+                raise ArgumentError, "The instance was not taken from this pool." unless @busy.delete(instance)
+
+                unless @closed
+                    @idle << instance
+                    @available.signal
+                end
+
+                @closed
+            end
+
+            instance.quit if closed
+        end
+
+        # Take an instance from the pool, yield it, and give it back.
+        #
+        # @param snapshot See Pool#checkout.
+        #
+        # Returns the result of the block.
+        def with(snapshot=nil)
+            instance = checkout(snapshot)
+
+            begin
+                return yield(instance)
+            ensure
+                release(instance)
+            end
+        end
+
+        # Quit all idle instances of this pool, and those in use once they are released.
+        # Any waiting or later Pool#checkout raises.
+        def shutdown
+            @lock.synchronize do
+                @idle.each(&:quit)
+                @idle.clear
+                @closed = true
+                @available.broadcast
+            end
+        end
+
+        # Starts the instance for the given slot, from its own copy of the library.
+        def start(slot)
+            directory = File.join(@configuration.output_directory, "pool_#{@configuration.name}")
+            FileUtils.mkdir_p directory
+
+            library = File.join(directory, "#{slot}_#{@configuration.library_name}")
+
+            unless File.exist?(library) && File.mtime(library) >= File.mtime(@configuration.library)
+                temp = "#{library}.#{Process.pid}.tmp"
+                FileUtils.cp(@configuration.library, temp)
+                File.rename(temp, library)
+            end
+
+            instance = Instance.new(@configuration, library)
+            @boot[instance] = instance.snapshot
+
+            return instance
+        end
+
+        private :start
+    end
+end
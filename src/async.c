@@ -0,0 +1,155 @@
+#include "async.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "debug.h"
+
+/* Thread running zemu_debug_continue in the background. */
+static pthread_t thread;
+
+/* Whether the thread has been created and not yet joined,
+ * and whether it has finished running.
+ */
+static zboolean started = FALSE;
+static zboolean finished = FALSE;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t finished_cond = PTHREAD_COND_INITIALIZER;
+
+/* Pipe to which a byte, the state from zemu_debug_state, is written whenever
+ * a background run stops, so that callers can wait for it with select or poll.
+ */
+static int events[2] = { -1, -1 };
+
+static Z80 * run_instance;
+static zint64 run_cycles_limit;
+
+static void * run(void * arg)
+{
+    zemu_debug_continue(run_instance, run_cycles_limit);
+
+    pthread_mutex_lock(&lock);
+    /* A pause made after the run returned, but before it was marked finished,
+     * must not stop the next run.
+     */
+    zemu_debug_cancel_stop();
+    finished = TRUE;
+    pthread_cond_broadcast(&finished_cond);
+    pthread_mutex_unlock(&lock);
+
+    zuint8 event = (zuint8)zemu_debug_state();
+    if (write(events[1], &event, 1) != 1) { /* The event is lost if the pipe is full. */ }
+
+    return NULL;
+}
+
+/* Returns the file descriptor from which a byte can be read whenever a background run stops.
+ * The descriptor is non-blocking, and remains open for the lifetime of the library.
+ */
+int zemu_async_fd(void)
+{
+    if (events[0] < 0)
+    {
+        if (pipe(events) != 0) return -1;
+
+        for (int i = 0; i < 2; i++)
+        {
+            fcntl(events[i], F_SETFD, FD_CLOEXEC);
+            fcntl(events[i], F_SETFL, fcntl(events[i], F_GETFL) | O_NONBLOCK);
+        }
+    }
+
+    return events[0];
+}
+
+/* Starts running the instance in a background thread, as zemu_debug_continue,
+ * and returns immediately.
+ *
+ * Returns false if the instance is already running, or the thread cannot be created.
+ */
+zboolean zemu_async_start(Z80 * instance, zint64 run_cycles)
+{
+    if (zemu_async_running()) return FALSE;
+    if (zemu_async_fd() < 0) return FALSE;
+
+    /* Join a previous run which has finished, but was not waited for. */
+    if (started) zemu_async_wait(-1);
+
+    run_instance = instance;
+    run_cycles_limit = run_cycles;
+    finished = FALSE;
+
+    if (pthread_create(&thread, NULL, run, NULL) != 0) return FALSE;
+
+    started = TRUE;
+    return TRUE;
+}
+
+/* Requests that a background run stops. It stops within ZEMU_DEBUG_QUANTUM cycles,
+ * in the ZEMU_DEBUG_STATE_INTERRUPTED state.
+ */
+void zemu_async_pause(void)
+{
+    /* The request is made under the lock, so that it cannot outlive the run it was aimed at. */
+    pthread_mutex_lock(&lock);
+    if (started && !finished) zemu_debug_stop();
+    pthread_mutex_unlock(&lock);
+}
+
+/* Waits for up to the given number of milliseconds (or indefinitely, if negative)
+ * for a background run to stop.
+ *
+ * Returns true if it has stopped, or none was started.
+ */
+zboolean zemu_async_wait(zint64 timeout_ms)
+{
+    if (!started) return TRUE;
+
+    pthread_mutex_lock(&lock);
+
+    if (timeout_ms < 0)
+    {
+        while (!finished) pthread_cond_wait(&finished_cond, &lock);
+    }
+    else
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        while (!finished)
+        {
+            if (pthread_cond_timedwait(&finished_cond, &lock, &deadline) != 0) break;
+        }
+    }
+
+    zboolean stopped = finished;
+    pthread_mutex_unlock(&lock);
+
+    if (stopped)
+    {
+        pthread_join(thread, NULL);
+        started = FALSE;
+    }
+
+    return stopped;
+}
+
+/* Returns true if a background run has been started and has not yet stopped. */
+zboolean zemu_async_running(void)
+{
+    pthread_mutex_lock(&lock);
+    zboolean running = started && !finished;
+    pthread_mutex_unlock(&lock);
+
+    return running;
+}
@@ -0,0 +1,12 @@
+#ifndef _ZEMU_ASYNC_H
+#define _ZEMU_ASYNC_H
+
+#include "emulation/CPU/Z80.h"
+
+zboolean zemu_async_start(Z80 * instance, zint64 run_cycles);
+void zemu_async_pause(void);
+zboolean zemu_async_wait(zint64 timeout_ms);
+zboolean zemu_async_running(void);
+int zemu_async_fd(void);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef _ZEMU_BLOCKS_H
+#define _ZEMU_BLOCKS_H
+
+#include "emulation/CPU/Z80.h"
+
+/* A run of instructions in read-only memory, found when the library was built
+ * by a configuration with the batch_blocks parameter set. See Zemu::Blocks.
+ *
+ * No instruction of a block but the last may branch, halt or repeat, so running
+ * the CPU for one cycle more than all but the last instruction take from the
+ * start of the block executes exactly the instructions of the block.
+ */
+#define ZEMU_BLOCK_LAST_CYCLES  23  /* Most T-states taken by the last instruction of a block. */
+
+typedef struct {
+    zuint16 cycles;         /* T-states taken by all but the last instruction. */
+    zuint8 instructions;    /* Number of instructions, or 0 if no block starts at this address. */
+} ZemuBlock;
+
+/* For each 256-byte page, the block starting at each address in the page,
+ * or NULL if no block starts in the page. Generated in blocks.c.
+ */
+extern const ZemuBlock * const zemu_blocks[0x100];
+
+/* Returns the block starting at the given address, or NULL. */
+static inline const ZemuBlock * zemu_block_at(zuint16 address)
+{
+    const ZemuBlock * page = zemu_blocks[address >> 8];
+    if (page == NULL || page[address & 0xFF].instructions == 0) return NULL;
+    return &page[address & 0xFF];
+}
+
+#endif
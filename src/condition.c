@@ -0,0 +1,112 @@
+#include "condition.h"
+
+#include "debug.h"
+#include "memory.h"
+
+/* Evaluates a breakpoint condition.
+ *
+ * Malformed code (which Zemu::Debug::Condition does not produce)
+ * evaluates as true, so that the breakpoint is not silently lost.
+ */
+zboolean zemu_condition_evaluate(Z80 * instance, const zuint8 * code, zusize length, zuint64 hits, zuint64 cycles)
+{
+    zuint64 stack[ZEMU_CONDITION_STACK];
+    zusize depth = 0;
+    zusize i = 0;
+
+    while (i < length)
+    {
+        zuint8 op = code[i++];
+
+        if (op == ZEMU_CONDITION_END)
+        {
+            return depth == 1 ? (stack[0] != 0) : TRUE;
+        }
+        else if (op < ZEMU_CONDITION_NOT)
+        {
+            /* Operands. */
+            if (depth >= ZEMU_CONDITION_STACK) return TRUE;
+
+            switch (op)
+            {
+                case ZEMU_CONDITION_CONSTANT:
+                {
+                    if (i + 8 > length) return TRUE;
+
+                    zuint64 value = 0;
+                    for (int b = 7; b >= 0; b--) value = (value << 8) | code[i + b];
+                    i += 8;
+
+                    stack[depth++] = value;
+                    break;
+                }
+
+                case ZEMU_CONDITION_REGISTER:
+                    if (i >= length) return TRUE;
+                    stack[depth++] = zemu_debug_register(instance, code[i++]);
+                    break;
+
+                case ZEMU_CONDITION_MEMORY:
+                    if (depth < 1) return TRUE;
+                    stack[depth - 1] = zemu_memory_peek((zuint16)stack[depth - 1]);
+                    break;
+
+                case ZEMU_CONDITION_HITS:
+                    stack[depth++] = hits;
+                    break;
+
+                case ZEMU_CONDITION_CYCLES:
+                    stack[depth++] = cycles;
+                    break;
+
+                default:
+                    return TRUE;
+            }
+        }
+        else if (op < ZEMU_CONDITION_ADD)
+        {
+            /* Unary operators. */
+            if (depth < 1) return TRUE;
+
+            zuint64 * a = &stack[depth - 1];
+
+            switch (op)
+            {
+                case ZEMU_CONDITION_NOT:    *a = !*a; break;
+                case ZEMU_CONDITION_NEGATE: *a = -*a; break;
+                case ZEMU_CONDITION_INVERT: *a = ~*a; break;
+                default:                    return TRUE;
+            }
+        }
+        else
+        {
+            /* Binary operators. */
+            if (depth < 2) return TRUE;
+
+            zuint64 b = stack[--depth];
+            zuint64 * a = &stack[depth - 1];
+
+            switch (op)
+            {
+                case ZEMU_CONDITION_ADD:            *a = *a + b; break;
+                case ZEMU_CONDITION_SUBTRACT:       *a = *a - b; break;
+                case ZEMU_CONDITION_AND:            *a = *a & b; break;
+                case ZEMU_CONDITION_OR:             *a = *a | b; break;
+                case ZEMU_CONDITION_XOR:            *a = *a ^ b; break;
+                case ZEMU_CONDITION_SHIFT_LEFT:     *a = (b < 64) ? (*a << b) : 0; break;
+                case ZEMU_CONDITION_SHIFT_RIGHT:    *a = (b < 64) ? (*a >> b) : 0; break;
+                case ZEMU_CONDITION_EQUAL:          *a = *a == b; break;
+                case ZEMU_CONDITION_NOT_EQUAL:      *a = *a != b; break;
+                case ZEMU_CONDITION_LESS:           *a = *a < b; break;
+                case ZEMU_CONDITION_LESS_EQUAL:     *a = *a <= b; break;
+                case ZEMU_CONDITION_GREATER:        *a = *a > b; break;
+                case ZEMU_CONDITION_GREATER_EQUAL:  *a = *a >= b; break;
+                case ZEMU_CONDITION_LOGICAL_AND:    *a = *a && b; break;
+                case ZEMU_CONDITION_LOGICAL_OR:     *a = *a || b; break;
+                default:                            return TRUE;
+            }
+        }
+    }
+
+    return TRUE;
+}
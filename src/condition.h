@@ -0,0 +1,44 @@
+#ifndef _ZEMU_CONDITION_H
+#define _ZEMU_CONDITION_H
+
+#include "emulation/CPU/Z80.h"
+
+/* Opcodes of the bytecode for breakpoint conditions.
+ * Conditions are compiled from expressions by Zemu::Debug::Condition,
+ * and evaluated on a stack of 64-bit values.
+ */
+#define ZEMU_CONDITION_END          0x00    /* Return whether the top of the stack is nonzero. */
+#define ZEMU_CONDITION_CONSTANT     0x01    /* Push the following 8-byte little-endian constant. */
+#define ZEMU_CONDITION_REGISTER     0x02    /* Push the register with the following ID (see zemu_debug_register). */
+#define ZEMU_CONDITION_MEMORY       0x03    /* Replace the address on top of the stack with the byte at it. */
+#define ZEMU_CONDITION_HITS         0x04    /* Push the number of times the breakpoint has been hit. */
+#define ZEMU_CONDITION_CYCLES       0x05    /* Push the number of cycles executed. */
+
+/* Unary operators. */
+#define ZEMU_CONDITION_NOT          0x10
+#define ZEMU_CONDITION_NEGATE       0x11
+#define ZEMU_CONDITION_INVERT       0x12
+
+/* Binary operators. */
+#define ZEMU_CONDITION_ADD          0x20
+#define ZEMU_CONDITION_SUBTRACT     0x21
+#define ZEMU_CONDITION_AND          0x22
+#define ZEMU_CONDITION_OR           0x23
+#define ZEMU_CONDITION_XOR          0x24
+#define ZEMU_CONDITION_SHIFT_LEFT   0x25
+#define ZEMU_CONDITION_SHIFT_RIGHT  0x26
+#define ZEMU_CONDITION_EQUAL        0x27
+#define ZEMU_CONDITION_NOT_EQUAL    0x28
+#define ZEMU_CONDITION_LESS         0x29
+#define ZEMU_CONDITION_LESS_EQUAL   0x2A
+#define ZEMU_CONDITION_GREATER      0x2B
+#define ZEMU_CONDITION_GREATER_EQUAL 0x2C
+#define ZEMU_CONDITION_LOGICAL_AND  0x2D
+#define ZEMU_CONDITION_LOGICAL_OR   0x2E
+
+/* Maximum depth of the stack. */
+#define ZEMU_CONDITION_STACK        32
+
+zboolean zemu_condition_evaluate(Z80 * instance, const zuint8 * code, zusize length, zuint64 hits, zuint64 cycles);
+
+#endif
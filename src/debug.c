@@ -1,18 +1,829 @@
 #include "debug.h"
 
+#include "blocks.h"
+#include "condition.h"
+#include "cpu.h"
+#include "disassemble.h"
+#include "fuzz.h"
+
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
 zboolean halted = FALSE;
 
-zusize zemu_debug_step(Z80 * instance)
+/* Program breakpoints, one bit per address, and the number of addresses with a breakpoint. */
+static zuint8 breakpoints[0x10000 / 8];
+static zusize breakpoint_count = 0;
+
+/* Conditions of conditional breakpoints, evaluated natively when the breakpoint is hit. */
+typedef struct {
+    zboolean used;
+    zuint16 address;
+    zuint64 hits;
+    zusize length;
+    zuint8 code[ZEMU_DEBUG_CONDITION_SIZE];
+} ZemuDebugCondition;
+
+static ZemuDebugCondition conditions[ZEMU_DEBUG_CONDITIONS];
+
+/* Number of cycles executed by zemu_debug_continue. While running, this is
+ * updated every ZEMU_DEBUG_QUANTUM cycles, so that it can be read from another thread.
+ */
+static zuint64 total_cycles = 0;
+
+/* Number of cycles executed since the instance was initialized, by any means.
+ * Used to timestamp bytes sent over serial links.
+ */
+static zuint64 elapsed_cycles = 0;
+
+/* Serial links to other machines, and the side of each link which is this machine. */
+static ZemuLink * links[ZEMU_DEBUG_LINKS];
+static zuint8 link_sides[ZEMU_DEBUG_LINKS];
+static zusize link_count = 0;
+
+/* Watchpoints, one bit per address, for each type of access. */
+static zuint8 watch_read[0x10000 / 8];
+static zuint8 watch_write[0x10000 / 8];
+
+/* Addresses whose watchpoint was set for both types of access at once,
+ * which debuggers report differently from separate read and write watchpoints.
+ */
+static zuint8 watch_access[0x10000 / 8];
+
+/* Number of addresses with a watchpoint of any type. */
+static zusize watchpoints = 0;
+
+/* Address and type of the access which hit a watchpoint. */
+static zboolean watch_hit = FALSE;
+static zuint16 watch_hit_address = 0;
+static zuint8 watch_hit_type = 0;
+
+/* Temporary breakpoint for zemu_debug_run_to, or -1.
+ * Only hit when SP is at least run_to_sp, so that a recursive call
+ * does not stop a step over.
+ */
+static zint32 run_to_address = -1;
+static zuint16 run_to_sp = 0;
+
+/* Whether zemu_debug_step_out is running, and the SP of the frame being stepped out of. */
+static zboolean step_out = FALSE;
+static zuint16 step_out_sp = 0;
+
+/* Pattern for zemu_debug_run_until_output, with its KMP failure function,
+ * the length of the prefix of it matched so far, and whether it has matched.
+ */
+static zuint8 output_pattern[ZEMU_DEBUG_PATTERN_SIZE];
+static zusize output_failure[ZEMU_DEBUG_PATTERN_SIZE];
+static zusize output_pattern_length = 0;
+static zusize output_matched_length = 0;
+static zboolean output_matched = FALSE;
+
+/* Reason for which the last call to zemu_debug_continue returned. */
+static zint32 state = ZEMU_DEBUG_STATE_RUNNING;
+
+/* Set to request that a running zemu_debug_continue returns. */
+static volatile sig_atomic_t stop_requested = 0;
+
+/* Clock speed in Hz to which execution is paced, or 0 to run as fast as possible. */
+static zuint64 pacing_clock_speed = 0;
+
+/* Host file descriptor with which serial IO is bridged, or -1. */
+static int bridge_fd = -1;
+static zuint64 bridge_delay_cycles = 0;
+
+/* Whether SIGINT stops a running zemu_debug_continue. */
+static zboolean interruptible = FALSE;
+
+/* Limits on the cycles, instructions and host time of each run, or 0 for no limit. */
+static zuint64 watchdog_cycles = 0;
+static zuint64 watchdog_instructions = 0;
+static zuint64 watchdog_nanoseconds = 0;
+
+/* Value of PC when the last call to zemu_debug_continue returned. */
+static zuint16 stop_pc = 0;
+
+/* Runs the primary CPU for at least the given number of cycles, finishing the instruction
+ * in progress, and the rest of the machine for as long.
+ */
+static zusize run(Z80 * instance, zusize min_cycles)
 {
-    /* Will run for at least one cycle. */
-    zusize cycles = z80_run(instance, 1);
+    zusize cycles = z80_run(instance, min_cycles);
 
     /* Execute the per-cycle behaviour of the peripheral devices. */
     for (zusize i = 0; i < cycles; i++) zemu_io_clock(instance);
 
+    elapsed_cycles += cycles;
+
+#if ZEMU_CPU_COUNT > 1
+    /* Keep the other CPUs in lockstep with the primary CPU. */
+    zemu_cpu_advance(cycles);
+#endif
+
+    return cycles;
+}
+
+zusize zemu_debug_step(Z80 * instance)
+{
+    /* Will run for at least one cycle. */
+    return run(instance, 1);
+}
+
+/* Resets the debugging state for a newly-initialized instance. */
+void zemu_debug_init(void)
+{
+    halted = FALSE;
+    state = ZEMU_DEBUG_STATE_RUNNING;
+    memset(breakpoints, 0, sizeof(breakpoints));
+    breakpoint_count = 0;
+    memset(conditions, 0, sizeof(conditions));
+    total_cycles = 0;
+    elapsed_cycles = 0;
+    stop_pc = 0;
+    link_count = 0;
+
+    memset(watch_read, 0, sizeof(watch_read));
+    memset(watch_write, 0, sizeof(watch_write));
+    memset(watch_access, 0, sizeof(watch_access));
+    watchpoints = 0;
+    watch_hit = FALSE;
+}
+
+/* Removes all breakpoints, watchpoints and watchdog limits, so that an instance
+ * can be reused as if newly initialized.
+ */
+void zemu_debug_clear(Z80 * instance)
+{
+    memset(breakpoints, 0, sizeof(breakpoints));
+    breakpoint_count = 0;
+    memset(conditions, 0, sizeof(conditions));
+
+    memset(watch_read, 0, sizeof(watch_read));
+    memset(watch_write, 0, sizeof(watch_write));
+    memset(watch_access, 0, sizeof(watch_access));
+    watchpoints = 0;
+    watch_hit = FALSE;
+
+    instance->read = zemu_memory_read;
+    instance->write = zemu_memory_write;
+
+    zemu_debug_set_watchdog(0, 0, 0);
+}
+
+/* Returns the condition of the breakpoint at the given address, or NULL if it has none. */
+static ZemuDebugCondition * find_condition(zuint16 address)
+{
+    for (zusize i = 0; i < ZEMU_DEBUG_CONDITIONS; i++)
+    {
+        if (conditions[i].used && conditions[i].address == address) return &conditions[i];
+    }
+
+    return NULL;
+}
+
+/* Returns true if the breakpoint at the given address is unconditional,
+ * or if its condition holds. Only called when the breakpoint bit is set.
+ */
+static zboolean check_condition(Z80 * instance, zuint16 address, zuint64 cycles)
+{
+    ZemuDebugCondition * condition = find_condition(address);
+    if (condition == NULL) return TRUE;
+
+    condition->hits++;
+
+    return zemu_condition_evaluate(instance, condition->code, condition->length, condition->hits, cycles);
+}
+
+/* Memory callbacks used in place of zemu_memory_read and zemu_memory_write
+ * while any watchpoints are set, so that there is no cost otherwise.
+ * Opcode fetches are reads, and so also hit read watchpoints.
+ */
+static zuint8 watched_read(void * context, zuint16 address)
+{
+    if (watch_read[address >> 3] & (1 << (address & 7)))
+    {
+        watch_hit = TRUE;
+        watch_hit_address = address;
+        watch_hit_type = ZEMU_DEBUG_WATCH_READ;
+    }
+
+    return zemu_memory_read(context, address);
+}
+
+static void watched_write(void * context, zuint16 address, zuint8 value)
+{
+    if (watch_write[address >> 3] & (1 << (address & 7)))
+    {
+        watch_hit = TRUE;
+        watch_hit_address = address;
+        watch_hit_type = ZEMU_DEBUG_WATCH_WRITE;
+    }
+
+    zemu_memory_write(context, address, value);
+}
+
+static void interrupt_handler(int signal)
+{
+    stop_requested = 1;
+}
+
+/* Returns the current host time in nanoseconds. */
+static zuint64 host_time(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((zuint64)t.tv_sec * 1000000000ULL) + (zuint64)t.tv_nsec;
+}
+
+/* Sleeps until the host time given in nanoseconds. */
+static void sleep_until(zuint64 time)
+{
+    zuint64 now = host_time();
+    if (now >= time) return;
+
+    struct timespec t;
+    t.tv_sec = (time - now) / 1000000000ULL;
+    t.tv_nsec = (time - now) % 1000000000ULL;
+    nanosleep(&t, NULL);
+}
+
+/* Publishes the cycle reached by this machine to each of its links. */
+static void publish_links(zboolean active)
+{
+    for (zusize i = 0; i < link_count; i++) zemu_link_publish(links[i], link_sides[i], elapsed_cycles, active);
+}
+
+/* Returns the cycle up to which this machine may run without waiting for the machines it is linked to. */
+static zuint64 link_bound(void)
+{
+    zuint64 bound = (zuint64)-1;
+
+    for (zusize i = 0; i < link_count; i++)
+    {
+        zuint64 b = zemu_link_bound(links[i], link_sides[i]);
+        if (b < bound) bound = b;
+    }
+
+    return bound;
+}
+
+/* Waits until the machines this machine is linked to have caught up, or a stop is requested.
+ * Returns the new cycle up to which this machine may run.
+ */
+static zuint64 sync_links(void)
+{
+    publish_links(TRUE);
+
+    zuint64 bound = link_bound();
+
+    for (zusize spins = 0; elapsed_cycles >= bound && !stop_requested; spins++)
+    {
+        /* Linked machines usually catch up quickly, so yield before sleeping. */
+        if (spins < 100)
+        {
+            sched_yield();
+        }
+        else
+        {
+            struct timespec ts = { 0, 10000 };
+            nanosleep(&ts, NULL);
+        }
+
+        bound = link_bound();
+    }
+
+    return bound;
+}
+
+/* Runs the instance until a breakpoint is hit, the CPU halts,
+ * the given number of cycles (or -1 for no limit) have been executed,
+ * or a stop is requested.
+ *
+ * Returns the number of cycles executed. The reason for returning
+ * is given by zemu_debug_state.
+ */
+zuint64 zemu_debug_continue(Z80 * instance, zint64 run_cycles)
+{
+    zuint64 cycles = 0;
+    zuint64 instructions = 0;
+
+    /* Cycle counts at which the next periodic checks are due. */
+    zuint64 next_quantum = ZEMU_DEBUG_QUANTUM;
+    zuint64 next_bridge = 0;
+
+    zuint64 start_time = host_time();
+    zuint64 start_cycles = total_cycles;
+
+    struct sigaction old_action;
+    int old_flags = 0;
+
+    if (halted)
+    {
+        state = ZEMU_DEBUG_STATE_HALTED;
+        publish_links(FALSE);
+        return 0;
+    }
+
+    watch_hit = FALSE;
+    state = ZEMU_DEBUG_STATE_RUNNING;
+
+    if (interruptible)
+    {
+        struct sigaction action;
+        action.sa_handler = interrupt_handler;
+        action.sa_flags = 0;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, &old_action);
+    }
+
+    if (bridge_fd >= 0)
+    {
+        old_flags = fcntl(bridge_fd, F_GETFL);
+        fcntl(bridge_fd, F_SETFL, old_flags | O_NONBLOCK);
+    }
+
+    /* Cycle at which this machine must next wait for the machines it is linked to. */
+    zuint64 next_sync = (link_count > 0) ? sync_links() : (zuint64)-1;
+
+    /* Blocks of instructions in ROM run at once, unless there is something to check after each instruction. */
+    zboolean run_blocks = (breakpoint_count == 0 && watchpoints == 0 && run_to_address < 0 && !step_out &&
+                           output_pattern_length == 0 && link_count == 0);
+
+    while ((run_cycles < 0 || cycles < (zuint64)run_cycles) && state == ZEMU_DEBUG_STATE_RUNNING)
+    {
+        /* Only decode the instruction when stepping out. */
+        zboolean returning = step_out && (zemu_disassemble_instruction(instance->state.pc)->flags & ZEMU_INSTRUCTION_RETURN);
+
+        const ZemuBlock * block = run_blocks ? zemu_block_at(instance->state.pc) : NULL;
+
+        /* A pending interrupt, or one raised by a device during the block,
+         * would be accepted part way through it. A block must also fit within
+         * the cycles left to run, so that short runs such as steps do not overshoot.
+         */
+        if (block != NULL && !instance->state.internal.irq && !instance->state.internal.nmi &&
+            block->cycles <= zemu_io_quiet() &&
+            (run_cycles < 0 || cycles + block->cycles + ZEMU_BLOCK_LAST_CYCLES <= (zuint64)run_cycles))
+        {
+            cycles += run(instance, block->cycles + 1u);
+            instructions += block->instructions;
+        }
+        else
+        {
+            cycles += zemu_debug_step(instance);
+            instructions++;
+        }
+
+        zuint16 pc = instance->state.pc;
+
+        if (zemu_fuzz_enabled) zemu_fuzz_edge(pc);
+
+        if (watch_hit)
+        {
+            state = ZEMU_DEBUG_STATE_WATCHPOINT;
+        }
+        else if ((breakpoints[pc >> 3] & (1 << (pc & 7))) && check_condition(instance, pc, start_cycles + cycles))
+        {
+            state = ZEMU_DEBUG_STATE_BREAK;
+        }
+        else if ((pc == run_to_address && instance->state.sp >= run_to_sp) ||
+                 (returning && instance->state.sp > step_out_sp) ||
+                 output_matched)
+        {
+            state = ZEMU_DEBUG_STATE_REACHED;
+        }
+        else if (halted)
+        {
+            state = ZEMU_DEBUG_STATE_HALTED;
+        }
+
+        if (elapsed_cycles >= next_sync)
+        {
+            next_sync = sync_links();
+            if (stop_requested && state == ZEMU_DEBUG_STATE_RUNNING) state = ZEMU_DEBUG_STATE_INTERRUPTED;
+        }
+
+        if (bridge_fd >= 0 && cycles >= next_bridge)
+        {
+            zemu_io_poll(bridge_fd);
+            next_bridge = cycles + ((bridge_delay_cycles > 0) ? bridge_delay_cycles : ZEMU_DEBUG_QUANTUM);
+        }
+
+        if (cycles >= next_quantum)
+        {
+            next_quantum = cycles + ZEMU_DEBUG_QUANTUM;
+
+            __atomic_store_n(&total_cycles, start_cycles + cycles, __ATOMIC_RELAXED);
+
+            if (link_count > 0) publish_links(TRUE);
+
+            if (stop_requested && state == ZEMU_DEBUG_STATE_RUNNING)
+            {
+                state = ZEMU_DEBUG_STATE_INTERRUPTED;
+            }
+
+            /* A runaway run stops at the first quantum past any of its limits. */
+            if (state == ZEMU_DEBUG_STATE_RUNNING &&
+                ((watchdog_cycles > 0 && cycles >= watchdog_cycles) ||
+                 (watchdog_instructions > 0 && instructions >= watchdog_instructions) ||
+                 (watchdog_nanoseconds > 0 && host_time() - start_time >= watchdog_nanoseconds)))
+            {
+                state = ZEMU_DEBUG_STATE_TIMEOUT;
+            }
+
+            /* Wait until the host has caught up with the emulated time. */
+            if (pacing_clock_speed > 0)
+            {
+                sleep_until(start_time + (zuint64)(((double)cycles * 1000000000.0) / (double)pacing_clock_speed));
+            }
+        }
+    }
+
+    if (bridge_fd >= 0)
+    {
+        fcntl(bridge_fd, F_SETFL, old_flags);
+    }
+
+    if (interruptible)
+    {
+        sigaction(SIGINT, &old_action, NULL);
+    }
+
+    /* Linked machines wait for this one to run again, unless it has halted. */
+    publish_links(state != ZEMU_DEBUG_STATE_HALTED);
+
+    __atomic_store_n(&total_cycles, start_cycles + cycles, __ATOMIC_RELAXED);
+
+    stop_pc = instance->state.pc;
+
+    /* A stop request only applies to the run during which it was made,
+     * or the next one if made before it started.
+     */
+    stop_requested = 0;
+
+    return cycles;
+}
+
+/* Returns the reason for which the last call to zemu_debug_continue returned. */
+zint32 zemu_debug_state(void)
+{
+    return state;
+}
+
+/* Runs as zemu_debug_continue, but also stops when the PC reaches the given address. */
+zuint64 zemu_debug_run_to(Z80 * instance, zuint16 address, zint64 run_cycles)
+{
+    run_to_address = address;
+    run_to_sp = 0;
+
+    zuint64 cycles = zemu_debug_continue(instance, run_cycles);
+
+    run_to_address = -1;
+
+    return cycles;
+}
+
+/* Pushes a 16-bit value onto the stack of the instance, without hitting watchpoints. */
+static void push(Z80 * instance, zuint16 value)
+{
+    zuint8 bytes[2] = { (zuint8)(value & 0xFF), (zuint8)(value >> 8) };
+
+    instance->state.sp -= 2;
+    zemu_memory_poke_block(instance->state.sp, 2, bytes);
+}
+
+/* Calls the function at the given address, as if from the sentinel address:
+ * pushes the arguments (so that the first is nearest the top of the stack) and
+ * the sentinel as the return address, then runs until the function returns to
+ * the sentinel. Once it has returned, the arguments are popped.
+ *
+ * Breakpoints, HALT and the cycle limit still stop execution. The state is
+ * ZEMU_DEBUG_STATE_REACHED only if the function returned.
+ *
+ * The stack must be in writable memory.
+ */
+zuint64 zemu_debug_call(Z80 * instance, zuint16 address, const zuint16 * arguments, zusize count, zuint16 sentinel, zint64 run_cycles)
+{
+    zuint16 sp = instance->state.sp;
+
+    for (zusize i = count; i > 0; i--) push(instance, arguments[i - 1]);
+    push(instance, sentinel);
+
+    instance->state.pc = address;
+
+    /* The call starts afresh even if the CPU had halted. */
+    zemu_debug_set_halted(instance, FALSE);
+
+    run_to_address = sentinel;
+    run_to_sp = (zuint16)(sp - 2 * count);
+
+    zuint64 cycles = zemu_debug_continue(instance, run_cycles);
+
+    run_to_address = -1;
+
+    if (state == ZEMU_DEBUG_STATE_REACHED) instance->state.sp = sp;
+
     return cycles;
 }
 
+/* Runs as zemu_debug_continue, but also stops as soon as the given pattern
+ * appears in the serial output of the emulated machine.
+ *
+ * Each byte of output is matched as it is written, so only new output is scanned.
+ */
+zuint64 zemu_debug_run_until_output(Z80 * instance, const zuint8 * pattern, zusize length, zint64 run_cycles)
+{
+    if (length == 0 || length > ZEMU_DEBUG_PATTERN_SIZE) return 0;
+
+    memcpy(output_pattern, pattern, length);
+
+    /* Build the failure function: the length of the longest proper prefix
+     * of pattern[0..i] which is also a suffix of it.
+     */
+    output_failure[0] = 0;
+    for (zusize i = 1, k = 0; i < length; i++)
+    {
+        while (k > 0 && pattern[i] != pattern[k]) k = output_failure[k - 1];
+        if (pattern[i] == pattern[k]) k++;
+        output_failure[i] = k;
+    }
+
+    output_pattern_length = length;
+    output_matched_length = 0;
+    output_matched = FALSE;
+
+    zuint64 cycles = zemu_debug_continue(instance, run_cycles);
+
+    output_pattern_length = 0;
+    output_matched = FALSE;
+
+    return cycles;
+}
+
+/* Called with each byte of serial output from the emulated machine. */
+void zemu_debug_output(zuint8 value)
+{
+    if (output_pattern_length == 0) return;
+
+    zusize k = output_matched_length;
+    while (k > 0 && value != output_pattern[k]) k = output_failure[k - 1];
+    if (value == output_pattern[k]) k++;
+
+    if (k == output_pattern_length)
+    {
+        output_matched = TRUE;
+        k = output_failure[k - 1];
+    }
+
+    output_matched_length = k;
+}
+
+/* Executes one instruction, or if it is a CALL, RST, DJNZ or repeating block
+ * instruction, runs until the instruction following it is reached in the
+ * same stack frame.
+ */
+zuint64 zemu_debug_step_over(Z80 * instance, zint64 run_cycles)
+{
+    const ZemuInstruction * instruction = zemu_disassemble_instruction(instance->state.pc);
+
+    if (!(instruction->flags & (ZEMU_INSTRUCTION_CALL | ZEMU_INSTRUCTION_LOOP | ZEMU_INSTRUCTION_REPEAT)))
+    {
+        zuint64 cycles = zemu_debug_continue(instance, 1);
+        if (state == ZEMU_DEBUG_STATE_RUNNING) state = ZEMU_DEBUG_STATE_REACHED;
+        return cycles;
+    }
+
+    run_to_address = (zuint16)(instruction->address + instruction->length);
+    run_to_sp = instance->state.sp;
+
+    zuint64 cycles = zemu_debug_continue(instance, run_cycles);
+
+    run_to_address = -1;
+
+    return cycles;
+}
+
+/* Runs as zemu_debug_continue, but also stops after a return instruction
+ * leaves the current stack frame.
+ */
+zuint64 zemu_debug_step_out(Z80 * instance, zint64 run_cycles)
+{
+    step_out = TRUE;
+    step_out_sp = instance->state.sp;
+
+    zuint64 cycles = zemu_debug_continue(instance, run_cycles);
+
+    step_out = FALSE;
+
+    return cycles;
+}
+
+/* Requests that a running zemu_debug_continue returns as soon as possible. */
+void zemu_debug_stop(void)
+{
+    stop_requested = 1;
+}
+
+/* Withdraws a stop request which has not yet been acted on. */
+void zemu_debug_cancel_stop(void)
+{
+    stop_requested = 0;
+}
+
+/* Sets or clears a program breakpoint at the given address. */
+void zemu_debug_set_breakpoint(zuint16 address, zboolean set)
+{
+    zuint8 bit = (zuint8)(1 << (address & 7));
+
+    if (set && !(breakpoints[address >> 3] & bit)) breakpoint_count++;
+    else if (!set && (breakpoints[address >> 3] & bit)) breakpoint_count--;
+
+    if (set) breakpoints[address >> 3] |= bit;
+    else breakpoints[address >> 3] &= (zuint8)~bit;
+}
+
+/* Sets the condition of the breakpoint at the given address, resetting its hit count,
+ * or removes the condition if code is NULL. The breakpoint itself is set separately.
+ *
+ * Returns false if there is no room for the condition.
+ */
+zboolean zemu_debug_set_condition(zuint16 address, const zuint8 * code, zusize length)
+{
+    ZemuDebugCondition * condition = find_condition(address);
+
+    if (code == NULL)
+    {
+        if (condition != NULL) condition->used = FALSE;
+        return TRUE;
+    }
+
+    if (length > ZEMU_DEBUG_CONDITION_SIZE) return FALSE;
+
+    for (zusize i = 0; condition == NULL && i < ZEMU_DEBUG_CONDITIONS; i++)
+    {
+        if (!conditions[i].used) condition = &conditions[i];
+    }
+
+    if (condition == NULL) return FALSE;
+
+    condition->used = TRUE;
+    condition->address = address;
+    condition->hits = 0;
+    condition->length = length;
+    memcpy(condition->code, code, length);
+
+    return TRUE;
+}
+
+/* Returns the number of times the conditional breakpoint at the given address has been hit,
+ * whether or not its condition held.
+ */
+zuint64 zemu_debug_hits(zuint16 address)
+{
+    ZemuDebugCondition * condition = find_condition(address);
+    return (condition == NULL) ? 0 : condition->hits;
+}
+
+/* Returns the number of cycles executed since the instance was initialized.
+ * This may be called while running in the background.
+ */
+zuint64 zemu_debug_cycles(void)
+{
+    return __atomic_load_n(&total_cycles, __ATOMIC_RELAXED);
+}
+
+/* Sets or clears a watchpoint for the given types of access at the given address.
+ * The memory callbacks of the instance are switched to check watchpoints only
+ * while any are set.
+ */
+void zemu_debug_set_watchpoint(Z80 * instance, zuint16 address, zuint8 type, zboolean set)
+{
+    zuint8 mask = (zuint8)(1 << (address & 7));
+    zboolean was_set = ((watch_read[address >> 3] | watch_write[address >> 3]) & mask) != 0;
+
+    if (type & ZEMU_DEBUG_WATCH_READ)
+    {
+        if (set) watch_read[address >> 3] |= mask;
+        else watch_read[address >> 3] &= (zuint8)~mask;
+    }
+
+    if (type & ZEMU_DEBUG_WATCH_WRITE)
+    {
+        if (set) watch_write[address >> 3] |= mask;
+        else watch_write[address >> 3] &= (zuint8)~mask;
+    }
+
+    if (set && type == (ZEMU_DEBUG_WATCH_READ | ZEMU_DEBUG_WATCH_WRITE)) watch_access[address >> 3] |= mask;
+    else if (!set) watch_access[address >> 3] &= (zuint8)~mask;
+
+    zboolean is_set = ((watch_read[address >> 3] | watch_write[address >> 3]) & mask) != 0;
+
+    if (is_set && !was_set) watchpoints++;
+    else if (was_set && !is_set) watchpoints--;
+
+    instance->read = (watchpoints > 0) ? watched_read : zemu_memory_read;
+    instance->write = (watchpoints > 0) ? watched_write : zemu_memory_write;
+}
+
+/* Returns the address of the access which hit a watchpoint. */
+zuint16 zemu_debug_watch_address(void)
+{
+    return watch_hit_address;
+}
+
+/* Returns the type of the access which hit a watchpoint. */
+zuint8 zemu_debug_watch_type(void)
+{
+    return watch_hit_type;
+}
+
+/* Returns true if the watchpoint which was hit was set for both types of access at once. */
+zboolean zemu_debug_watch_access(void)
+{
+    return (watch_access[watch_hit_address >> 3] & (1 << (watch_hit_address & 7))) != 0;
+}
+
+/* Sets the clock speed in Hz to which zemu_debug_continue paces execution,
+ * or 0 to run as fast as possible.
+ */
+void zemu_debug_set_pacing(zuint64 clock_speed)
+{
+    pacing_clock_speed = clock_speed;
+}
+
+/* Sets limits on the cycles, instructions and host time in nanoseconds of each subsequent
+ * run of zemu_debug_continue, which stops in the ZEMU_DEBUG_STATE_TIMEOUT state once any
+ * limit is exceeded. Limits are checked every ZEMU_DEBUG_QUANTUM cycles. 0 means no limit.
+ */
+void zemu_debug_set_watchdog(zuint64 cycles, zuint64 instructions, zuint64 nanoseconds)
+{
+    watchdog_cycles = cycles;
+    watchdog_instructions = instructions;
+    watchdog_nanoseconds = nanoseconds;
+}
+
+/* Returns the value of PC when the last call to zemu_debug_continue returned. */
+zuint16 zemu_debug_stop_pc(void)
+{
+    return stop_pc;
+}
+
+/* Returns the number of cycles executed since the instance was initialized. */
+zuint64 zemu_debug_now(void)
+{
+    return elapsed_cycles;
+}
+
+/* Adds a serial link to be kept in step with by zemu_debug_continue.
+ * Returns FALSE if the maximum number of links has been reached.
+ */
+zboolean zemu_debug_add_link(ZemuLink * link, zuint8 side)
+{
+    if (link_count >= ZEMU_DEBUG_LINKS) return FALSE;
+
+    links[link_count] = link;
+    link_sides[link_count] = side;
+    link_count++;
+
+    zemu_link_publish(link, side, elapsed_cycles, !halted);
+
+    return TRUE;
+}
+
+/* Removes a serial link added with zemu_debug_add_link. */
+void zemu_debug_remove_link(ZemuLink * link, zuint8 side)
+{
+    for (zusize i = 0; i < link_count; i++)
+    {
+        if (links[i] == link && link_sides[i] == side)
+        {
+            zemu_link_publish(link, side, elapsed_cycles, FALSE);
+
+            link_count--;
+            links[i] = links[link_count];
+            link_sides[i] = link_sides[link_count];
+            return;
+        }
+    }
+}
+
+/* Sets a host file descriptor with which zemu_debug_continue bridges the serial IO
+ * of the emulated machine, every delay_cycles cycles. An fd of -1 disables bridging.
+ */
+void zemu_debug_set_bridge(int fd, zuint64 delay_cycles)
+{
+    bridge_fd = fd;
+    bridge_delay_cycles = delay_cycles;
+}
+
+/* Sets whether SIGINT stops a running zemu_debug_continue. */
+void zemu_debug_set_interruptible(zboolean value)
+{
+    interruptible = value;
+}
+
 zuint16 zemu_debug_register(Z80 * instance, zuint16 r)
 {
     switch (r)
@@ -49,10 +860,134 @@ zuint16 zemu_debug_register(Z80 * instance, zuint16 r)
         case 18:    return instance->state.hl_.values_uint8.index1;
         case 19:    return instance->state.hl_.values_uint8.index0;
 
+        /* Interrupt and refresh registers, and interrupt state. */
+        case 20:    return instance->state.i;
+        case 21:    return instance->state.r;
+        case 22:    return instance->state.internal.iff1;
+        case 23:    return instance->state.internal.iff2;
+        case 24:    return instance->state.internal.im;
+
         default:    return 0xFFFF;
     }
 }
 
+/* Sets the value of a register, identified as for zemu_debug_register. */
+void zemu_debug_set_register(Z80 * instance, zuint16 r, zuint16 value)
+{
+    zuint8 byte = (zuint8)value;
+
+    switch (r)
+    {
+        /* Special purpose registers. */
+        case 0:     instance->state.pc = value; break;
+        case 1:     instance->state.sp = value; break;
+        case 2:     instance->state.iy.value_uint16 = value; break;
+        case 3:     instance->state.ix.value_uint16 = value; break;
+
+        /* Main register set, 8-bit format. */
+        case 4:     instance->state.af.values_uint8.index1 = byte; break;
+        case 5:     instance->state.af.values_uint8.index0 = byte; break;
+
+        case 6:     instance->state.bc.values_uint8.index1 = byte; break;
+        case 7:     instance->state.bc.values_uint8.index0 = byte; break;
+
+        case 8:     instance->state.de.values_uint8.index1 = byte; break;
+        case 9:     instance->state.de.values_uint8.index0 = byte; break;
+
+        case 10:    instance->state.hl.values_uint8.index1 = byte; break;
+        case 11:    instance->state.hl.values_uint8.index0 = byte; break;
+
+        /* Alternate register set, 8-bit format. */
+        case 12:    instance->state.af_.values_uint8.index1 = byte; break;
+        case 13:    instance->state.af_.values_uint8.index0 = byte; break;
+
+        case 14:    instance->state.bc_.values_uint8.index1 = byte; break;
+        case 15:    instance->state.bc_.values_uint8.index0 = byte; break;
+
+        case 16:    instance->state.de_.values_uint8.index1 = byte; break;
+        case 17:    instance->state.de_.values_uint8.index0 = byte; break;
+
+        case 18:    instance->state.hl_.values_uint8.index1 = byte; break;
+        case 19:    instance->state.hl_.values_uint8.index0 = byte; break;
+
+        /* Interrupt and refresh registers, and interrupt state. */
+        case 20:    instance->state.i = byte; break;
+        case 21:    instance->state.r = byte; break;
+        case 22:    instance->state.internal.iff1 = (byte != 0); break;
+        case 23:    instance->state.internal.iff2 = (byte != 0); break;
+        case 24:    instance->state.internal.im = byte & 3; break;
+
+        default:    break;
+    }
+}
+
+/* Reads the full state of the CPU. */
+void zemu_debug_get_state(Z80 * instance, ZemuState * out)
+{
+    out->pc = instance->state.pc;
+    out->sp = instance->state.sp;
+
+    out->af = instance->state.af.value_uint16;
+    out->bc = instance->state.bc.value_uint16;
+    out->de = instance->state.de.value_uint16;
+    out->hl = instance->state.hl.value_uint16;
+    out->ix = instance->state.ix.value_uint16;
+    out->iy = instance->state.iy.value_uint16;
+
+    out->af_ = instance->state.af_.value_uint16;
+    out->bc_ = instance->state.bc_.value_uint16;
+    out->de_ = instance->state.de_.value_uint16;
+    out->hl_ = instance->state.hl_.value_uint16;
+
+    out->i = instance->state.i;
+    out->r = instance->state.r;
+
+    out->iff1 = instance->state.internal.iff1;
+    out->iff2 = instance->state.internal.iff2;
+    out->im = instance->state.internal.im;
+
+    out->halted = (zemu_cpu_index(instance->context) == 0) ? halted : instance->state.internal.halt;
+}
+
+/* Writes the full state of the CPU, including the halt latch. */
+void zemu_debug_set_state(Z80 * instance, const ZemuState * in)
+{
+    instance->state.pc = in->pc;
+    instance->state.sp = in->sp;
+
+    instance->state.af.value_uint16 = in->af;
+    instance->state.bc.value_uint16 = in->bc;
+    instance->state.de.value_uint16 = in->de;
+    instance->state.hl.value_uint16 = in->hl;
+    instance->state.ix.value_uint16 = in->ix;
+    instance->state.iy.value_uint16 = in->iy;
+
+    instance->state.af_.value_uint16 = in->af_;
+    instance->state.bc_.value_uint16 = in->bc_;
+    instance->state.de_.value_uint16 = in->de_;
+    instance->state.hl_.value_uint16 = in->hl_;
+
+    instance->state.i = in->i;
+    instance->state.r = in->r;
+
+    instance->state.internal.iff1 = (in->iff1 != 0);
+    instance->state.internal.iff2 = (in->iff2 != 0);
+    instance->state.internal.im = in->im & 3;
+
+    zemu_debug_set_halted(instance, in->halted != 0);
+}
+
+/* Sets or clears the halt latch, both in the CPU and as seen by zemu_debug_continue.
+ * Clearing it lets execution continue after a HALT.
+ */
+void zemu_debug_set_halted(Z80 * instance, zboolean state)
+{
+    instance->state.internal.halt = state;
+
+    /* Only the primary CPU halting stops the emulator. */
+    if (zemu_cpu_index(instance->context) == 0) halted = state;
+}
+
 zuint16 zemu_debug_pc(Z80 * instance)
 {
     return instance->state.pc;
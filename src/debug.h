@@ -2,17 +2,37 @@
 
 #include <stdio.h>
 
+#include "zemu.h"
+
 #include "memory.h"
 #include "io.h"
+#include "link.h"
+
+/* Maximum number of conditional breakpoints, and length of the code of each condition. */
+#define ZEMU_DEBUG_CONDITIONS           64
+#define ZEMU_DEBUG_CONDITION_SIZE       256
+
+/* Maximum length of a pattern for zemu_debug_run_until_output. */
+#define ZEMU_DEBUG_PATTERN_SIZE         256
+
+/* Number of cycles between checks for pacing, serial bridging and stop requests. */
+#define ZEMU_DEBUG_QUANTUM              1000
+
+/* Maximum number of serial links to other machines. */
+#define ZEMU_DEBUG_LINKS                8
 
-zusize zemu_debug_step(Z80 * instance);
+/* Functions used within the library. The public API is declared in zemu.h. */
+void zemu_debug_init(void);
+
+void zemu_debug_output(zuint8 value);
+void zemu_debug_set_bridge(int fd, zuint64 delay_cycles);
+
+zboolean zemu_debug_add_link(ZemuLink * link, zuint8 side);
+void zemu_debug_remove_link(ZemuLink * link, zuint8 side);
 
 void zemu_debug_halt(void * context, zboolean state);
 
-zboolean zemu_debug_halted(void);
 zboolean zemu_debug_break(void);
+void zemu_debug_cancel_stop(void);
+zboolean zemu_debug_watch_access(void);
 zboolean zemu_debug_running(void);
-
-zuint16 zemu_debug_register(Z80 * instance, zuint16 r);
-
-zuint16 zemu_debug_pc(Z80 * instance);
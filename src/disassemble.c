@@ -0,0 +1,650 @@
+#include "disassemble.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "memory.h"
+
+zuint32 zemu_disassemble_page_writes[0x100];
+
+/* Decoded instructions, indexed by address.
+ * An entry is valid if its page has not been written since it was decoded.
+ */
+static ZemuInstruction cache[0x10000];
+static zuint32 cache_stamp[0x10000];
+static zboolean cache_valid[0x10000];
+
+static const char * const r_names[8] = { "B", "C", "D", "E", "H", "L", "(HL)", "A" };
+static const char * const rp_names[4] = { "BC", "DE", "HL", "SP" };
+static const char * const rp2_names[4] = { "BC", "DE", "HL", "AF" };
+static const char * const cc_names[8] = { "NZ", "Z", "NC", "C", "PO", "PE", "P", "M" };
+static const char * const alu_names[8] = { "ADD", "ADC", "SUB", "SBC", "AND", "XOR", "OR", "CP" };
+static const char * const rot_names[8] = { "RLC", "RRC", "RL", "RR", "SLA", "SRA", "SLL", "SRL" };
+static const char * const acc_names[8] = { "RLCA", "RRCA", "RLA", "RRA", "DAA", "CPL", "SCF", "CCF" };
+static const char * const im_modes[8] = { "0", "0/1", "1", "2", "0", "0/1", "1", "2" };
+
+static const char * const block_names[4][4] = {
+    { "LDI",  "CPI",  "INI",  "OUTI" },
+    { "LDD",  "CPD",  "IND",  "OUTD" },
+    { "LDIR", "CPIR", "INIR", "OTIR" },
+    { "LDDR", "CPDR", "INDR", "OTDR" }
+};
+
+/* State of the decoding of a single instruction. */
+typedef struct {
+    ZemuInstruction * instruction;
+
+    /* Name of the index register selected by a DD or FD prefix, or NULL. */
+    const char * index;
+
+    /* Indexed memory operand, e.g. "(IX+$05)", once the displacement is fetched. */
+    char indexed[12];
+
+    /* Whether the instruction was affected by the index prefix. */
+    zboolean used_index;
+} Decoder;
+
+/* Fetches the next byte of the instruction. */
+static zuint8 fetch(Decoder * d)
+{
+    ZemuInstruction * i = d->instruction;
+    return zemu_memory_peek((zuint16)(i->address + i->length++));
+}
+
+/* Fetches a 16-bit little-endian value. */
+static zuint16 fetch16(Decoder * d)
+{
+    zuint16 lo = fetch(d);
+    zuint16 hi = fetch(d);
+    return (zuint16)((hi << 8) | lo);
+}
+
+/* Fetches the displacement of an indexed memory operand, if not already fetched. */
+static const char * indexed(Decoder * d)
+{
+    if (d->indexed[0] == '\0')
+    {
+        zint8 e = (zint8)fetch(d);
+        snprintf(d->indexed, sizeof(d->indexed), "(%s%c$%02X)", d->index, (e < 0) ? '-' : '+', (e < 0) ? -e : e);
+    }
+
+    d->used_index = TRUE;
+    return d->indexed;
+}
+
+/* Name of the 16-bit register HL, or the index register replacing it. */
+static const char * hl(Decoder * d)
+{
+    if (d->index == NULL) return "HL";
+
+    d->used_index = TRUE;
+    return d->index;
+}
+
+/* Name of an 8-bit register operand.
+ * With an index prefix, (HL) becomes an indexed memory operand, and H and L
+ * become the halves of the index register unless the instruction also
+ * accesses memory through an indexed operand.
+ */
+static const char * reg8(Decoder * d, int n, zboolean memory)
+{
+    static const char * const index_halves[2][2] = { { "IXH", "IXL" }, { "IYH", "IYL" } };
+
+    if (d->index == NULL) return r_names[n];
+
+    if (n == 6) return indexed(d);
+
+    if ((n == 4 || n == 5) && !memory)
+    {
+        d->used_index = TRUE;
+        return index_halves[d->index[1] == 'Y'][n - 4];
+    }
+
+    return r_names[n];
+}
+
+/* Name of a register pair from the table used by most instructions. */
+static const char * rp(Decoder * d, int p)
+{
+    return (p == 2) ? hl(d) : rp_names[p];
+}
+
+/* Name of a register pair from the table used by PUSH and POP. */
+static const char * rp2(Decoder * d, int p)
+{
+    return (p == 2) ? hl(d) : rp2_names[p];
+}
+
+/* Sets the mnemonic and operands of the instruction being decoded. */
+static void set(Decoder * d, const char * mnemonic, const char * format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+static void set(Decoder * d, const char * mnemonic, const char * format, ...)
+{
+    va_list args;
+
+    snprintf(d->instruction->mnemonic, sizeof(d->instruction->mnemonic), "%s", mnemonic);
+
+    va_start(args, format);
+    vsnprintf(d->instruction->operands, sizeof(d->instruction->operands), format, args);
+    va_end(args);
+}
+
+/* Sets the cycle counts of the instruction being decoded. */
+static void cycles(Decoder * d, zuint8 not_taken, zuint8 taken)
+{
+    d->instruction->cycles = not_taken;
+    d->instruction->cycles_taken = taken;
+}
+
+/* Sets the branch target of the instruction being decoded. */
+static void target(Decoder * d, zuint16 address)
+{
+    d->instruction->target = address;
+    d->instruction->flags |= ZEMU_INSTRUCTION_TARGET;
+}
+
+/* Decodes an instruction with the CB prefix.
+ * With an index prefix, the displacement precedes the opcode.
+ */
+static void decode_cb(Decoder * d)
+{
+    const char * operand;
+    zuint8 op;
+
+    if (d->index != NULL)
+    {
+        operand = indexed(d);
+        op = fetch(d);
+    }
+    else
+    {
+        op = fetch(d);
+        operand = r_names[op & 7];
+    }
+
+    int x = op >> 6;
+    int y = (op >> 3) & 7;
+    int z = op & 7;
+
+    /* Undocumented indexed forms also copy the result to a register. */
+    char result[8] = "";
+    if (d->index != NULL && z != 6 && x != 1) snprintf(result, sizeof(result), ",%s", r_names[z]);
+
+    zboolean memory = (d->index != NULL) || (z == 6);
+
+    switch (x)
+    {
+        case 0:
+            set(d, rot_names[y], "%s%s", operand, result);
+            cycles(d, (d->index != NULL) ? 23 : (memory ? 15 : 8), 0);
+            break;
+
+        case 1:
+            set(d, "BIT", "%d,%s", y, operand);
+            cycles(d, (d->index != NULL) ? 20 : (memory ? 12 : 8), 0);
+            break;
+
+        default:
+            set(d, (x == 2) ? "RES" : "SET", "%d,%s%s", y, operand, result);
+            cycles(d, (d->index != NULL) ? 23 : (memory ? 15 : 8), 0);
+            break;
+    }
+}
+
+/* Decodes an instruction with the ED prefix. */
+static void decode_ed(Decoder * d)
+{
+    zuint8 op = fetch(d);
+
+    int x = op >> 6;
+    int y = (op >> 3) & 7;
+    int z = op & 7;
+    int p = y >> 1;
+    int q = y & 1;
+
+    if (x == 1)
+    {
+        switch (z)
+        {
+            case 0:
+                if (y == 6) set(d, "IN", "F,(C)");
+                else set(d, "IN", "%s,(C)", r_names[y]);
+                cycles(d, 12, 0);
+                return;
+
+            case 1:
+                if (y == 6) set(d, "OUT", "(C),0");
+                else set(d, "OUT", "(C),%s", r_names[y]);
+                cycles(d, 12, 0);
+                return;
+
+            case 2:
+                set(d, q ? "ADC" : "SBC", "HL,%s", rp_names[p]);
+                cycles(d, 15, 0);
+                return;
+
+            case 3:
+            {
+                zuint16 nn = fetch16(d);
+                if (q) set(d, "LD", "%s,($%04X)", rp_names[p], nn);
+                else set(d, "LD", "($%04X),%s", nn, rp_names[p]);
+                cycles(d, 20, 0);
+                return;
+            }
+
+            case 4:
+                set(d, "NEG", "%s", "");
+                cycles(d, 8, 0);
+                return;
+
+            case 5:
+                set(d, (y == 1) ? "RETI" : "RETN", "%s", "");
+                cycles(d, 14, 0);
+                d->instruction->flags |= ZEMU_INSTRUCTION_BRANCH | ZEMU_INSTRUCTION_RETURN;
+                return;
+
+            case 6:
+                set(d, "IM", "%s", im_modes[y]);
+                cycles(d, 8, 0);
+                return;
+
+            default:
+                switch (y)
+                {
+                    case 0: set(d, "LD", "I,A"); cycles(d, 9, 0); return;
+                    case 1: set(d, "LD", "R,A"); cycles(d, 9, 0); return;
+                    case 2: set(d, "LD", "A,I"); cycles(d, 9, 0); return;
+                    case 3: set(d, "LD", "A,R"); cycles(d, 9, 0); return;
+                    case 4: set(d, "RRD", "%s", ""); cycles(d, 18, 0); return;
+                    case 5: set(d, "RLD", "%s", ""); cycles(d, 18, 0); return;
+                    default: break;
+                }
+                break;
+        }
+    }
+    else if (x == 2 && z <= 3 && y >= 4)
+    {
+        set(d, block_names[y - 4][z], "%s", "");
+
+        if (y >= 6)
+        {
+            cycles(d, 16, 21);
+            d->instruction->flags |= ZEMU_INSTRUCTION_REPEAT;
+        }
+        else
+        {
+            cycles(d, 16, 0);
+        }
+        return;
+    }
+
+    /* Invalid instructions execute as an 8 T-state NOP. */
+    set(d, "NOP*", "%s", "");
+    cycles(d, 8, 0);
+}
+
+/* Decodes an unprefixed instruction, or one with a DD or FD prefix. */
+static void decode_main(Decoder * d)
+{
+    ZemuInstruction * i = d->instruction;
+    zuint8 op = fetch(d);
+
+    int x = op >> 6;
+    int y = (op >> 3) & 7;
+    int z = op & 7;
+    int p = y >> 1;
+    int q = y & 1;
+
+    /* Whether an indexed instruction accesses memory through (IX+d),
+     * in which case its cycle count is given in full rather than as an
+     * addition to that of the unprefixed instruction.
+     */
+    zboolean full = FALSE;
+
+    switch (x)
+    {
+        case 0:
+            switch (z)
+            {
+                case 0:
+                    if (y == 0) { set(d, "NOP", "%s", ""); cycles(d, 4, 0); }
+                    else if (y == 1) { set(d, "EX", "AF,AF'"); cycles(d, 4, 0); }
+                    else
+                    {
+                        zint8 e = (zint8)fetch(d);
+                        target(d, (zuint16)(i->address + i->length + e));
+                        i->flags |= ZEMU_INSTRUCTION_BRANCH;
+
+                        if (y == 2)
+                        {
+                            set(d, "DJNZ", "$%04X", i->target);
+                            cycles(d, 8, 13);
+                            i->flags |= ZEMU_INSTRUCTION_CONDITIONAL | ZEMU_INSTRUCTION_LOOP;
+                        }
+                        else if (y == 3)
+                        {
+                            set(d, "JR", "$%04X", i->target);
+                            cycles(d, 12, 12);
+                        }
+                        else
+                        {
+                            set(d, "JR", "%s,$%04X", cc_names[y - 4], i->target);
+                            cycles(d, 7, 12);
+                            i->flags |= ZEMU_INSTRUCTION_CONDITIONAL;
+                        }
+                    }
+                    break;
+
+                case 1:
+                    if (q == 0)
+                    {
+                        const char * r = rp(d, p);
+                        set(d, "LD", "%s,$%04X", r, fetch16(d));
+                        cycles(d, 10, 0);
+                    }
+                    else
+                    {
+                        const char * r = hl(d);
+                        set(d, "ADD", "%s,%s", r, rp(d, p));
+                        cycles(d, 11, 0);
+                    }
+                    break;
+
+                case 2:
+                    switch (y)
+                    {
+                        case 0: set(d, "LD", "(BC),A"); cycles(d, 7, 0); break;
+                        case 1: set(d, "LD", "A,(BC)"); cycles(d, 7, 0); break;
+                        case 2: set(d, "LD", "(DE),A"); cycles(d, 7, 0); break;
+                        case 3: set(d, "LD", "A,(DE)"); cycles(d, 7, 0); break;
+                        case 4:
+                        {
+                            const char * r = hl(d);
+                            set(d, "LD", "($%04X),%s", fetch16(d), r);
+                            cycles(d, 16, 0);
+                            break;
+                        }
+                        case 5:
+                        {
+                            const char * r = hl(d);
+                            set(d, "LD", "%s,($%04X)", r, fetch16(d));
+                            cycles(d, 16, 0);
+                            break;
+                        }
+                        case 6: set(d, "LD", "($%04X),A", fetch16(d)); cycles(d, 13, 0); break;
+                        default: set(d, "LD", "A,($%04X)", fetch16(d)); cycles(d, 13, 0); break;
+                    }
+                    break;
+
+                case 3:
+                    set(d, q ? "DEC" : "INC", "%s", rp(d, p));
+                    cycles(d, 6, 0);
+                    break;
+
+                case 4:
+                case 5:
+                    set(d, (z == 4) ? "INC" : "DEC", "%s", reg8(d, y, FALSE));
+                    if (y == 6) { cycles(d, (d->index != NULL) ? 23 : 11, 0); full = TRUE; }
+                    else cycles(d, 4, 0);
+                    break;
+
+                case 6:
+                {
+                    const char * r = reg8(d, y, FALSE);
+                    set(d, "LD", "%s,$%02X", r, fetch(d));
+                    if (y == 6) { cycles(d, (d->index != NULL) ? 19 : 10, 0); full = TRUE; }
+                    else cycles(d, 7, 0);
+                    break;
+                }
+
+                default:
+                    set(d, acc_names[y], "%s", "");
+                    cycles(d, 4, 0);
+                    break;
+            }
+            break;
+
+        case 1:
+            if (y == 6 && z == 6)
+            {
+                set(d, "HALT", "%s", "");
+                cycles(d, 4, 0);
+                i->flags |= ZEMU_INSTRUCTION_HALT;
+            }
+            else
+            {
+                zboolean memory = (y == 6 || z == 6);
+                const char * dst = reg8(d, y, memory);
+                const char * src = reg8(d, z, memory);
+                set(d, "LD", "%s,%s", dst, src);
+                if (memory) { cycles(d, (d->index != NULL) ? 19 : 7, 0); full = TRUE; }
+                else cycles(d, 4, 0);
+            }
+            break;
+
+        case 2:
+        {
+            const char * r = reg8(d, z, FALSE);
+            if (y == 0 || y == 1 || y == 3) set(d, alu_names[y], "A,%s", r);
+            else set(d, alu_names[y], "%s", r);
+            if (z == 6) { cycles(d, (d->index != NULL) ? 19 : 7, 0); full = TRUE; }
+            else cycles(d, 4, 0);
+            break;
+        }
+
+        default:
+            switch (z)
+            {
+                case 0:
+                    set(d, "RET", "%s", cc_names[y]);
+                    cycles(d, 5, 11);
+                    i->flags |= ZEMU_INSTRUCTION_BRANCH | ZEMU_INSTRUCTION_CONDITIONAL | ZEMU_INSTRUCTION_RETURN;
+                    break;
+
+                case 1:
+                    if (q == 0)
+                    {
+                        set(d, "POP", "%s", rp2(d, p));
+                        cycles(d, 10, 0);
+                    }
+                    else switch (p)
+                    {
+                        case 0:
+                            set(d, "RET", "%s", "");
+                            cycles(d, 10, 10);
+                            i->flags |= ZEMU_INSTRUCTION_BRANCH | ZEMU_INSTRUCTION_RETURN;
+                            break;
+                        case 1: set(d, "EXX", "%s", ""); cycles(d, 4, 0); break;
+                        case 2:
+                            set(d, "JP", "(%s)", hl(d));
+                            cycles(d, 4, 4);
+                            i->flags |= ZEMU_INSTRUCTION_BRANCH;
+                            break;
+                        default:
+                        {
+                            const char * r = hl(d);
+                            set(d, "LD", "SP,%s", r);
+                            cycles(d, 6, 0);
+                            break;
+                        }
+                    }
+                    break;
+
+                case 2:
+                    target(d, fetch16(d));
+                    set(d, "JP", "%s,$%04X", cc_names[y], i->target);
+                    cycles(d, 10, 10);
+                    i->flags |= ZEMU_INSTRUCTION_BRANCH | ZEMU_INSTRUCTION_CONDITIONAL;
+                    break;
+
+                case 3:
+                    switch (y)
+                    {
+                        case 0:
+                            target(d, fetch16(d));
+                            set(d, "JP", "$%04X", i->target);
+                            cycles(d, 10, 10);
+                            i->flags |= ZEMU_INSTRUCTION_BRANCH;
+                            break;
+                        case 1: decode_cb(d); return;
+                        case 2: set(d, "OUT", "($%02X),A", fetch(d)); cycles(d, 11, 0); break;
+                        case 3: set(d, "IN", "A,($%02X)", fetch(d)); cycles(d, 11, 0); break;
+                        case 4: set(d, "EX", "(SP),%s", hl(d)); cycles(d, 19, 0); break;
+                        case 5: set(d, "EX", "DE,HL"); cycles(d, 4, 0); break;
+                        case 6: set(d, "DI", "%s", ""); cycles(d, 4, 0); break;
+                        default: set(d, "EI", "%s", ""); cycles(d, 4, 0); break;
+                    }
+                    break;
+
+                case 4:
+                    target(d, fetch16(d));
+                    set(d, "CALL", "%s,$%04X", cc_names[y], i->target);
+                    cycles(d, 10, 17);
+                    i->flags |= ZEMU_INSTRUCTION_BRANCH | ZEMU_INSTRUCTION_CONDITIONAL | ZEMU_INSTRUCTION_CALL;
+                    break;
+
+                case 5:
+                    if (q == 0)
+                    {
+                        set(d, "PUSH", "%s", rp2(d, p));
+                        cycles(d, 11, 0);
+                    }
+                    else
+                    {
+                        /* The DD, ED and FD prefixes (p = 1, 2, 3) are handled by decode. */
+                        target(d, fetch16(d));
+                        set(d, "CALL", "$%04X", i->target);
+                        cycles(d, 17, 17);
+                        i->flags |= ZEMU_INSTRUCTION_BRANCH | ZEMU_INSTRUCTION_CALL;
+                    }
+                    break;
+
+                case 6:
+                {
+                    zuint8 n = fetch(d);
+                    if (y == 0 || y == 1 || y == 3) set(d, alu_names[y], "A,$%02X", n);
+                    else set(d, alu_names[y], "$%02X", n);
+                    cycles(d, 7, 0);
+                    break;
+                }
+
+                default:
+                    target(d, (zuint16)(y * 8));
+                    set(d, "RST", "$%02X", i->target);
+                    cycles(d, 11, 11);
+                    i->flags |= ZEMU_INSTRUCTION_BRANCH | ZEMU_INSTRUCTION_CALL;
+                    break;
+            }
+            break;
+    }
+
+    /* The index prefix adds 4 T-states to the unprefixed instruction. */
+    if (d->index != NULL && !full)
+    {
+        i->cycles += 4;
+        if (i->cycles_taken) i->cycles_taken += 4;
+    }
+}
+
+/* Decodes the instruction at the given address. */
+static void decode(zuint16 address, ZemuInstruction * instruction)
+{
+    Decoder d;
+
+    memset(instruction, 0, sizeof(*instruction));
+    instruction->address = address;
+
+    d.instruction = instruction;
+    d.index = NULL;
+    d.indexed[0] = '\0';
+    d.used_index = FALSE;
+
+    zuint8 op = zemu_memory_peek(address);
+
+    if (op == 0xCB)
+    {
+        instruction->length = 1;
+        decode_cb(&d);
+    }
+    else if (op == 0xED)
+    {
+        instruction->length = 1;
+        decode_ed(&d);
+    }
+    else if (op == 0xDD || op == 0xFD)
+    {
+        zuint8 next = zemu_memory_peek((zuint16)(address + 1));
+
+        d.index = (op == 0xDD) ? "IX" : "IY";
+        instruction->length = 1;
+
+        if (next != 0xDD && next != 0xED && next != 0xFD)
+        {
+            decode_main(&d);
+        }
+
+        /* A prefix which does not affect the following instruction
+         * executes as a 4 T-state NOP.
+         */
+        if (!d.used_index)
+        {
+            memset(instruction, 0, sizeof(*instruction));
+            instruction->address = address;
+            instruction->length = 1;
+            d.instruction = instruction;
+            set(&d, "NOP*", "%s", "");
+            cycles(&d, 4, 0);
+        }
+    }
+    else
+    {
+        decode_main(&d);
+    }
+
+    /* Unconditional branches have the same cycle count either way. */
+    if (!(instruction->flags & (ZEMU_INSTRUCTION_CONDITIONAL | ZEMU_INSTRUCTION_REPEAT)))
+    {
+        instruction->cycles_taken = instruction->cycles;
+    }
+}
+
+/* Returns the decoded instruction at the given address.
+ * Instructions are cached, until the memory in which they lie is written.
+ */
+const ZemuInstruction * zemu_disassemble_instruction(zuint16 address)
+{
+    zuint32 stamp = zemu_disassemble_page_writes[address >> 8];
+
+    if (cache_valid[address] && cache_stamp[address] == stamp)
+    {
+        return &cache[address];
+    }
+
+    ZemuInstruction * instruction = &cache[address];
+    decode(address, instruction);
+
+    /* Instructions which cross into another page are not cached,
+     * as a write to the second page would not invalidate them.
+     */
+    zuint16 last = (zuint16)(address + instruction->length - 1);
+    cache_valid[address] = ((last >> 8) == (address >> 8));
+    cache_stamp[address] = stamp;
+
+    return instruction;
+}
+
+/* Disassembles count consecutive instructions, starting at the given address.
+ * Returns the number of instructions disassembled.
+ */
+zusize zemu_disassemble(zuint16 address, zusize count, ZemuInstruction * instructions)
+{
+    for (zusize i = 0; i < count; i++)
+    {
+        instructions[i] = *zemu_disassemble_instruction(address);
+        address = (zuint16)(address + instructions[i].length);
+    }
+
+    return count;
+}
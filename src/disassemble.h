@@ -0,0 +1,43 @@
+#ifndef _ZEMU_DISASSEMBLE_H
+#define _ZEMU_DISASSEMBLE_H
+
+#include "emulation/CPU/Z80.h"
+
+/* Flags describing the control flow of a decoded instruction. */
+#define ZEMU_INSTRUCTION_BRANCH         0x01    /* May transfer control to another address. */
+#define ZEMU_INSTRUCTION_CONDITIONAL    0x02    /* The transfer of control depends on a condition. */
+#define ZEMU_INSTRUCTION_CALL           0x04    /* Pushes a return address (CALL, RST). */
+#define ZEMU_INSTRUCTION_RETURN         0x08    /* Pops a return address (RET, RETI, RETN). */
+#define ZEMU_INSTRUCTION_REPEAT         0x10    /* Repeats until a condition is met (LDIR, CPIR, etc.). */
+#define ZEMU_INSTRUCTION_LOOP           0x20    /* Decrements B and branches back (DJNZ). */
+#define ZEMU_INSTRUCTION_HALT           0x40    /* Halts the CPU. */
+#define ZEMU_INSTRUCTION_TARGET         0x80    /* The target field holds the branch target. */
+
+/* A decoded instruction. */
+typedef struct {
+    zuint16 address;
+    zuint16 target;
+    zuint8 length;
+    zuint8 cycles;          /* T-states if a condition is false, or on the final iteration. */
+    zuint8 cycles_taken;    /* T-states if a condition is true, or on a repeated iteration. */
+    zuint8 flags;
+    char mnemonic[6];
+    char operands[18];
+} ZemuInstruction;
+
+/* Number of writes to each 256-byte page of memory.
+ * Incremented by zemu_memory_write, and used to invalidate cached instructions.
+ */
+extern zuint32 zemu_disassemble_page_writes[0x100];
+
+/* Marks any cached instructions in the page containing the given address as invalid. */
+static inline void zemu_disassemble_invalidate(zuint16 address)
+{
+    zemu_disassemble_page_writes[address >> 8]++;
+}
+
+const ZemuInstruction * zemu_disassemble_instruction(zuint16 address);
+
+zusize zemu_disassemble(zuint16 address, zusize count, ZemuInstruction * instructions);
+
+#endif
@@ -0,0 +1,110 @@
+#include "fuzz.h"
+
+#include "cpu.h"
+#include "debug.h"
+#include "io.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ZEMU_FUZZ_LIBFUZZER
+/* libFuzzer reads this section as extra coverage counters, alongside any
+ * instrumentation of the emulator itself, and clears it before each input.
+ */
+__attribute__((section("__libfuzzer_extra_counters")))
+#endif
+zuint8 zemu_fuzz_map[ZEMU_FUZZ_MAP_SIZE];
+
+zboolean zemu_fuzz_enabled = FALSE;
+zuint16 zemu_fuzz_previous = 0;
+
+/* State of the machine restored before each input. */
+static zuint8 * snapshot_memory = NULL;
+static ZemuState snapshot_cpus[ZEMU_CPU_COUNT];
+
+/* Serial port to which each input is fed, and the number of cycles for which each input runs. */
+static char fuzz_serial[64] = "";
+static zint64 fuzz_cycles = -1;
+
+/* Prepares for fuzzing from the current state of the machine, which is restored before each input.
+ * Each input is fed to the named serial port, and runs for up to run_cycles cycles (-1 for no limit).
+ *
+ * Returns FALSE if there is no serial port with the given name, or if the snapshot cannot be allocated.
+ */
+zboolean zemu_fuzz_setup(const char * serial, zint64 run_cycles)
+{
+    zemu_fuzz_end();
+
+    if (strlen(serial) >= sizeof(fuzz_serial) || !zemu_io_feed(serial, NULL, 0)) return FALSE;
+
+    snapshot_memory = malloc(zemu_memory_snapshot_size() + 1);
+    if (snapshot_memory == NULL) return FALSE;
+
+    zemu_memory_save(snapshot_memory);
+
+    for (zusize i = 0; i < ZEMU_CPU_COUNT; i++) zemu_debug_get_state(zemu_cpu(i), &snapshot_cpus[i]);
+
+    strcpy(fuzz_serial, serial);
+    fuzz_cycles = run_cycles;
+    zemu_fuzz_enabled = TRUE;
+
+    return TRUE;
+}
+
+/* Runs one input: restores the snapshot taken by zemu_fuzz_setup, clears the coverage map,
+ * and runs with the input available to be read from the serial port.
+ * The input must remain valid until this returns.
+ *
+ * Breakpoints, watchpoints and watchdog limits apply as to zemu_debug_continue.
+ * IO devices other than the serial port are not restored.
+ *
+ * Returns the number of cycles executed. zemu_debug_state gives the reason the run stopped.
+ */
+zuint64 zemu_fuzz_one(Z80 * instance, const zuint8 * data, zusize size)
+{
+    if (!zemu_fuzz_enabled) return 0;
+
+    zemu_memory_restore(snapshot_memory);
+
+    for (zusize i = 0; i < ZEMU_CPU_COUNT; i++) zemu_debug_set_state(zemu_cpu(i), &snapshot_cpus[i]);
+
+    memset(zemu_fuzz_map, 0, sizeof(zemu_fuzz_map));
+    zemu_fuzz_previous = 0;
+
+    zemu_io_feed(fuzz_serial, data, size);
+
+    zuint64 cycles = zemu_debug_continue(instance, fuzz_cycles);
+
+    /* Do not keep a reference to the input once it is no longer valid. */
+    zemu_io_feed(fuzz_serial, NULL, 0);
+
+    return cycles;
+}
+
+/* Returns the number of distinct edges executed by the last input. */
+zusize zemu_fuzz_edges(void)
+{
+    zusize edges = 0;
+
+    for (zusize i = 0; i < ZEMU_FUZZ_MAP_SIZE; i++)
+    {
+        if (zemu_fuzz_map[i] != 0) edges++;
+    }
+
+    return edges;
+}
+
+/* Copies the coverage map of the last input into buffer, which must be ZEMU_FUZZ_MAP_SIZE bytes long. */
+void zemu_fuzz_coverage(zuint8 * buffer)
+{
+    memcpy(buffer, zemu_fuzz_map, sizeof(zemu_fuzz_map));
+}
+
+/* Stops recording coverage, and frees the snapshot. */
+void zemu_fuzz_end(void)
+{
+    free(snapshot_memory);
+    snapshot_memory = NULL;
+
+    zemu_fuzz_enabled = FALSE;
+}
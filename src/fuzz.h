@@ -0,0 +1,38 @@
+#ifndef _ZEMU_FUZZ_H
+#define _ZEMU_FUZZ_H
+
+#include "emulation/CPU/Z80.h"
+
+/* Number of counters in the edge coverage map. A power of two no larger than 0x10000. */
+#define ZEMU_FUZZ_MAP_SIZE 0x10000
+
+/* Hit counts of edges between instructions, indexed as in AFL by the address of
+ * an instruction XORed with half the address of the instruction executed before it.
+ * Counters wrap around.
+ */
+extern zuint8 zemu_fuzz_map[ZEMU_FUZZ_MAP_SIZE];
+
+/* Whether zemu_debug_continue records coverage. Set by zemu_fuzz_setup. */
+extern zboolean zemu_fuzz_enabled;
+
+/* Half the address of the last instruction executed while recording coverage. */
+extern zuint16 zemu_fuzz_previous;
+
+/* Records the edge from the last instruction executed to the instruction at pc. */
+static inline void zemu_fuzz_edge(zuint16 pc)
+{
+    zemu_fuzz_map[(pc ^ zemu_fuzz_previous) & (ZEMU_FUZZ_MAP_SIZE - 1)]++;
+    zemu_fuzz_previous = pc >> 1;
+}
+
+zboolean zemu_fuzz_setup(const char * serial, zint64 run_cycles);
+
+zuint64 zemu_fuzz_one(Z80 * instance, const zuint8 * data, zusize size);
+
+zusize zemu_fuzz_edges(void);
+
+void zemu_fuzz_coverage(zuint8 * buffer);
+
+void zemu_fuzz_end(void);
+
+#endif
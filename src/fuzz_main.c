@@ -0,0 +1,89 @@
+/* Entry points of a libFuzzer target, built by Zemu::build_fuzzer.
+ *
+ * The machine boots once, from reset until the address ZEMU_FUZZ_ENTRY is reached, or for
+ * ZEMU_FUZZ_BOOT_CYCLES cycles if there is no entry address. Each input then runs from the
+ * booted machine for up to ZEMU_FUZZ_CYCLES cycles, fed to the serial port ZEMU_FUZZ_SERIAL.
+ * Reaching any of the addresses listed in ZEMU_FUZZ_CRASH is reported to libFuzzer as a crash.
+ */
+
+#include "zemu.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef ZEMU_FUZZ_SERIAL
+#error "ZEMU_FUZZ_SERIAL must be defined as the name of a serial port."
+#endif
+
+#ifndef ZEMU_FUZZ_CYCLES
+#define ZEMU_FUZZ_CYCLES        1000000
+#endif
+
+#ifndef ZEMU_FUZZ_BOOT_CYCLES
+#define ZEMU_FUZZ_BOOT_CYCLES   0
+#endif
+
+#ifndef ZEMU_FUZZ_ENTRY
+#define ZEMU_FUZZ_ENTRY         -1
+#endif
+
+/* A comma-terminated list of addresses, such as 0x0038,0x1234, */
+#ifndef ZEMU_FUZZ_CRASH
+#define ZEMU_FUZZ_CRASH
+#endif
+
+#define ZEMU_FUZZ_STRING_(x)    #x
+#define ZEMU_FUZZ_STRING(x)     ZEMU_FUZZ_STRING_(x)
+
+static const zint32 crash_addresses[] = { ZEMU_FUZZ_CRASH -1 };
+
+static Z80 * instance = NULL;
+
+int LLVMFuzzerInitialize(int * argc, char *** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    instance = zemu_init();
+    zemu_power_on(instance);
+    zemu_reset(instance);
+
+    if (ZEMU_FUZZ_ENTRY >= 0)
+    {
+        zemu_debug_run_to(instance, ZEMU_FUZZ_ENTRY, (ZEMU_FUZZ_BOOT_CYCLES > 0) ? ZEMU_FUZZ_BOOT_CYCLES : -1);
+
+        if (zemu_debug_state() != ZEMU_DEBUG_STATE_REACHED)
+        {
+            fprintf(stderr, "zemu: the machine did not reach 0x%04x while booting.\n", (unsigned int)ZEMU_FUZZ_ENTRY);
+            exit(1);
+        }
+    }
+    else
+    {
+        zemu_debug_continue(instance, ZEMU_FUZZ_BOOT_CYCLES);
+    }
+
+    for (zusize i = 0; crash_addresses[i] >= 0; i++) zemu_debug_set_breakpoint(crash_addresses[i], TRUE);
+
+    if (!zemu_fuzz_setup(ZEMU_FUZZ_STRING(ZEMU_FUZZ_SERIAL), ZEMU_FUZZ_CYCLES))
+    {
+        fprintf(stderr, "zemu: could not set up fuzzing of serial port %s.\n", ZEMU_FUZZ_STRING(ZEMU_FUZZ_SERIAL));
+        exit(1);
+    }
+
+    return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size)
+{
+    zemu_fuzz_one(instance, data, size);
+
+    if (zemu_debug_state() == ZEMU_DEBUG_STATE_BREAK)
+    {
+        fprintf(stderr, "zemu: reached 0x%04x\n", zemu_debug_stop_pc());
+        abort();
+    }
+
+    return 0;
+}
@@ -0,0 +1,672 @@
+#include "gdb.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "memory.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/* Number of registers in the order GDB expects them for the Z80:
+ * AF, BC, DE, HL, SP, PC, IX, IY, AF', BC', DE', HL', IR.
+ */
+#define ZEMU_GDB_REGISTERS      13
+
+/* A connection to a debugger. */
+typedef struct {
+    int fd;
+    zboolean ack;
+
+    /* Buffered input from the debugger. */
+    zuint8 input[0x1000];
+    zusize input_position;
+    zusize input_length;
+} ZemuGDBConnection;
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* Parses a hexadecimal number, advancing the pointer past it. */
+static zuint32 parse_hex(const char ** p)
+{
+    zuint32 value = 0;
+    int digit;
+
+    while ((digit = hex_value(**p)) >= 0)
+    {
+        value = (value << 4) | (zuint32)digit;
+        (*p)++;
+    }
+
+    return value;
+}
+
+/* Returns the next character from the debugger, or -1 if the connection is closed. */
+static int gdb_getc(ZemuGDBConnection * connection)
+{
+    if (connection->input_position >= connection->input_length)
+    {
+        ssize_t length = recv(connection->fd, connection->input, sizeof(connection->input), 0);
+        if (length <= 0) return -1;
+
+        connection->input_position = 0;
+        connection->input_length = (zusize)length;
+    }
+
+    return connection->input[connection->input_position++];
+}
+
+/* Returns true if input from the debugger is waiting to be read. */
+static zboolean gdb_pending(ZemuGDBConnection * connection)
+{
+    if (connection->input_position < connection->input_length) return TRUE;
+
+    struct pollfd p = { connection->fd, POLLIN, 0 };
+    return poll(&p, 1, 0) > 0;
+}
+
+static zboolean gdb_write(ZemuGDBConnection * connection, const char * data, zusize length)
+{
+    while (length > 0)
+    {
+        ssize_t written = send(connection->fd, data, length, MSG_NOSIGNAL);
+        if (written <= 0) return FALSE;
+
+        data += written;
+        length -= (zusize)written;
+    }
+
+    return TRUE;
+}
+
+/* Sends a packet, waiting for it to be acknowledged unless in no-ack mode.
+ * Returns false if the connection is closed.
+ */
+static zboolean gdb_send(ZemuGDBConnection * connection, const char * data)
+{
+    static char packet[ZEMU_GDB_PACKET_SIZE + 4];
+
+    zusize length = strlen(data);
+    zuint8 checksum = 0;
+
+    packet[0] = '$';
+    for (zusize i = 0; i < length; i++)
+    {
+        packet[i + 1] = data[i];
+        checksum += (zuint8)data[i];
+    }
+    packet[length + 1] = '#';
+    packet[length + 2] = hex_digits[checksum >> 4];
+    packet[length + 3] = hex_digits[checksum & 0xF];
+
+    for (;;)
+    {
+        if (!gdb_write(connection, packet, length + 4)) return FALSE;
+        if (!connection->ack) return TRUE;
+
+        int c;
+        do
+        {
+            c = gdb_getc(connection);
+            if (c < 0) return FALSE;
+        } while (c != '+' && c != '-');
+
+        if (c == '+') return TRUE;
+    }
+}
+
+/* Receives a packet into the buffer given, acknowledging it unless in no-ack mode.
+ * Returns false if the connection is closed.
+ */
+static zboolean gdb_receive(ZemuGDBConnection * connection, char * packet)
+{
+    for (;;)
+    {
+        int c;
+
+        /* Skip anything outside a packet, including stray acknowledgements and interrupts. */
+        do
+        {
+            c = gdb_getc(connection);
+            if (c < 0) return FALSE;
+        } while (c != '$');
+
+        zusize length = 0;
+        zuint8 checksum = 0;
+
+        while ((c = gdb_getc(connection)) != '#')
+        {
+            if (c < 0) return FALSE;
+            if (length < ZEMU_GDB_PACKET_SIZE) packet[length++] = (char)c;
+            checksum += (zuint8)c;
+        }
+        packet[length] = '\0';
+
+        int high = gdb_getc(connection);
+        int low = gdb_getc(connection);
+        if (high < 0 || low < 0) return FALSE;
+
+        zboolean valid = (hex_value((char)high) << 4 | hex_value((char)low)) == checksum;
+
+        if (connection->ack)
+        {
+            if (!gdb_write(connection, valid ? "+" : "-", 1)) return FALSE;
+        }
+
+        if (valid || !connection->ack) return TRUE;
+    }
+}
+
+static zuint16 gdb_get_register(Z80 * instance, zuint32 r)
+{
+    switch (r)
+    {
+        case 0:     return instance->state.af.value_uint16;
+        case 1:     return instance->state.bc.value_uint16;
+        case 2:     return instance->state.de.value_uint16;
+        case 3:     return instance->state.hl.value_uint16;
+        case 4:     return instance->state.sp;
+        case 5:     return instance->state.pc;
+        case 6:     return instance->state.ix.value_uint16;
+        case 7:     return instance->state.iy.value_uint16;
+        case 8:     return instance->state.af_.value_uint16;
+        case 9:     return instance->state.bc_.value_uint16;
+        case 10:    return instance->state.de_.value_uint16;
+        case 11:    return instance->state.hl_.value_uint16;
+        case 12:    return (zuint16)((instance->state.i << 8) | instance->state.r);
+        default:    return 0;
+    }
+}
+
+static void gdb_set_register(Z80 * instance, zuint32 r, zuint16 value)
+{
+    switch (r)
+    {
+        case 0:     instance->state.af.value_uint16 = value; break;
+        case 1:     instance->state.bc.value_uint16 = value; break;
+        case 2:     instance->state.de.value_uint16 = value; break;
+        case 3:     instance->state.hl.value_uint16 = value; break;
+        case 4:     instance->state.sp = value; break;
+        case 5:     instance->state.pc = value; break;
+        case 6:     instance->state.ix.value_uint16 = value; break;
+        case 7:     instance->state.iy.value_uint16 = value; break;
+        case 8:     instance->state.af_.value_uint16 = value; break;
+        case 9:     instance->state.bc_.value_uint16 = value; break;
+        case 10:    instance->state.de_.value_uint16 = value; break;
+        case 11:    instance->state.hl_.value_uint16 = value; break;
+        case 12:    instance->state.i = (zuint8)(value >> 8); instance->state.r = (zuint8)value; break;
+        default:    break;
+    }
+}
+
+/* Writes a register value in target (little-endian) byte order. */
+static char * gdb_format_register(char * out, zuint16 value)
+{
+    *out++ = hex_digits[(value >> 4) & 0xF];
+    *out++ = hex_digits[value & 0xF];
+    *out++ = hex_digits[(value >> 12) & 0xF];
+    *out++ = hex_digits[(value >> 8) & 0xF];
+    return out;
+}
+
+static zuint16 gdb_parse_register(const char * in)
+{
+    int digits[4];
+
+    for (int i = 0; i < 4; i++)
+    {
+        digits[i] = hex_value(in[i]);
+        if (digits[i] < 0) return 0;
+    }
+
+    return (zuint16)((digits[2] << 12) | (digits[3] << 8) | (digits[0] << 4) | digits[1]);
+}
+
+/* Sends the reply for the reason that execution stopped. */
+static zboolean gdb_stop_reply(ZemuGDBConnection * connection, zboolean interrupted)
+{
+    char reply[32];
+
+    if (interrupted)
+    {
+        return gdb_send(connection, "S02");
+    }
+    else if (zemu_debug_state() == ZEMU_DEBUG_STATE_WATCHPOINT)
+    {
+        zuint16 address = zemu_debug_watch_address();
+        const char * kind = zemu_debug_watch_access() ? "awatch" :
+                            (zemu_debug_watch_type() == ZEMU_DEBUG_WATCH_WRITE) ? "watch" : "rwatch";
+
+        snprintf(reply, sizeof(reply), "T05%s:%04x;", kind, address);
+        return gdb_send(connection, reply);
+    }
+
+    return gdb_send(connection, "S05");
+}
+
+/* Runs natively until a stop, checking for an interrupt from the debugger between slices.
+ * Returns false if the connection is closed.
+ */
+static zboolean gdb_continue(ZemuGDBConnection * connection, Z80 * instance)
+{
+    zboolean interrupted = FALSE;
+
+    for (;;)
+    {
+        zemu_debug_continue(instance, ZEMU_GDB_SLICE);
+        if (zemu_debug_state() != ZEMU_DEBUG_STATE_RUNNING) break;
+
+        if (gdb_pending(connection))
+        {
+            int c = gdb_getc(connection);
+            if (c < 0) return FALSE;
+
+            if (c == 0x03)
+            {
+                interrupted = TRUE;
+                break;
+            }
+        }
+    }
+
+    return gdb_stop_reply(connection, interrupted);
+}
+
+static zboolean gdb_step(ZemuGDBConnection * connection, Z80 * instance)
+{
+    zemu_debug_continue(instance, 1);
+    return gdb_stop_reply(connection, FALSE);
+}
+
+/* Handles a Z or z packet, setting or clearing a breakpoint or watchpoint. */
+static const char * gdb_breakpoint(Z80 * instance, const char * p, zboolean set)
+{
+    zuint32 type = parse_hex(&p);
+    if (*p++ != ',') return "E01";
+
+    zuint32 address = parse_hex(&p);
+    if (*p++ != ',') return "E01";
+
+    zuint32 kind = parse_hex(&p);
+    if (address > 0xFFFF) return "E01";
+
+    switch (type)
+    {
+        /* Software and hardware breakpoints are the same. */
+        case 0:
+        case 1:
+            zemu_debug_set_breakpoint((zuint16)address, set);
+            return "OK";
+
+        case 2:
+        case 3:
+        case 4:
+        {
+            zuint8 access = (type == 2) ? ZEMU_DEBUG_WATCH_WRITE :
+                            (type == 3) ? ZEMU_DEBUG_WATCH_READ :
+                            (ZEMU_DEBUG_WATCH_READ | ZEMU_DEBUG_WATCH_WRITE);
+
+            if (kind == 0) kind = 1;
+            for (zuint32 a = address; a < address + kind && a <= 0xFFFF; a++)
+            {
+                zemu_debug_set_watchpoint(instance, (zuint16)a, access, set);
+            }
+            return "OK";
+        }
+
+        default:
+            return "";
+    }
+}
+
+/* Handles packets from the debugger until it detaches or the connection is closed. */
+static zint32 gdb_session(ZemuGDBConnection * connection, Z80 * instance)
+{
+    static char packet[ZEMU_GDB_PACKET_SIZE + 1];
+    static char reply[ZEMU_GDB_PACKET_SIZE + 1];
+    static zuint8 buffer[ZEMU_GDB_PACKET_SIZE / 2];
+
+    while (gdb_receive(connection, packet))
+    {
+        const char * p = packet + 1;
+        const char * response = reply;
+        reply[0] = '\0';
+
+        switch (packet[0])
+        {
+            case '?':
+                if (!gdb_stop_reply(connection, FALSE)) return ZEMU_GDB_DISCONNECTED;
+                continue;
+
+            case 'g':
+            {
+                char * out = reply;
+                for (zuint32 r = 0; r < ZEMU_GDB_REGISTERS; r++)
+                {
+                    out = gdb_format_register(out, gdb_get_register(instance, r));
+                }
+                *out = '\0';
+                break;
+            }
+
+            case 'G':
+                for (zuint32 r = 0; r < ZEMU_GDB_REGISTERS && strlen(p) >= 4; r++, p += 4)
+                {
+                    gdb_set_register(instance, r, gdb_parse_register(p));
+                }
+                response = "OK";
+                break;
+
+            case 'p':
+            {
+                zuint32 r = parse_hex(&p);
+                if (r >= ZEMU_GDB_REGISTERS) { response = "E01"; break; }
+                *gdb_format_register(reply, gdb_get_register(instance, r)) = '\0';
+                break;
+            }
+
+            case 'P':
+            {
+                zuint32 r = parse_hex(&p);
+                if (r >= ZEMU_GDB_REGISTERS || *p++ != '=') { response = "E01"; break; }
+                gdb_set_register(instance, r, gdb_parse_register(p));
+                response = "OK";
+                break;
+            }
+
+            case 'm':
+            {
+                zuint32 address = parse_hex(&p);
+                if (*p++ != ',' || address > 0xFFFF) { response = "E01"; break; }
+
+                zuint32 length = parse_hex(&p);
+                if (length > sizeof(buffer)) length = sizeof(buffer);
+                if (address + length > 0x10000) length = 0x10000 - address;
+
+                zemu_memory_peek_block((zuint16)address, length, buffer);
+
+                for (zuint32 i = 0; i < length; i++)
+                {
+                    reply[i * 2] = hex_digits[buffer[i] >> 4];
+                    reply[i * 2 + 1] = hex_digits[buffer[i] & 0xF];
+                }
+                reply[length * 2] = '\0';
+                break;
+            }
+
+            case 'M':
+            {
+                zuint32 address = parse_hex(&p);
+                if (*p++ != ',' || address > 0xFFFF) { response = "E01"; break; }
+
+                zuint32 length = parse_hex(&p);
+                if (*p++ != ':' || length > sizeof(buffer) || address + length > 0x10000) { response = "E01"; break; }
+
+                /* The data must be exactly length bytes of hex, or nothing is written. */
+                zboolean valid = (strlen(p) == length * 2);
+                for (zuint32 i = 0; valid && i < length; i++)
+                {
+                    int high = hex_value(p[i * 2]);
+                    int low = hex_value(p[i * 2 + 1]);
+                    if (high < 0 || low < 0) valid = FALSE;
+                    else buffer[i] = (zuint8)((high << 4) | low);
+                }
+
+                if (!valid) { response = "E01"; break; }
+
+                /* Read-only memory cannot be written. */
+                zusize written = zemu_memory_poke_block((zuint16)address, length, buffer);
+                response = (written == length) ? "OK" : "E0e";
+                break;
+            }
+
+            case 'c':
+            case 's':
+                if (*p) instance->state.pc = (zuint16)parse_hex(&p);
+                if (!((packet[0] == 'c') ? gdb_continue(connection, instance) : gdb_step(connection, instance)))
+                {
+                    return ZEMU_GDB_DISCONNECTED;
+                }
+                continue;
+
+            case 'C':
+            case 'S':
+                /* Signals have no meaning here, and are ignored. */
+                parse_hex(&p);
+                if (*p == ';')
+                {
+                    p++;
+                    instance->state.pc = (zuint16)parse_hex(&p);
+                }
+                if (!((packet[0] == 'C') ? gdb_continue(connection, instance) : gdb_step(connection, instance)))
+                {
+                    return ZEMU_GDB_DISCONNECTED;
+                }
+                continue;
+
+            case 'v':
+                if (strcmp(packet, "vCont?") == 0)
+                {
+                    response = "vCont;c;C;s;S";
+                }
+                else if (strncmp(packet, "vCont;", 6) == 0)
+                {
+                    /* There is a single thread, so only the first action applies. */
+                    char action = packet[6];
+
+                    if (action == 'c' || action == 'C')
+                    {
+                        if (!gdb_continue(connection, instance)) return ZEMU_GDB_DISCONNECTED;
+                        continue;
+                    }
+                    else if (action == 's' || action == 'S')
+                    {
+                        if (!gdb_step(connection, instance)) return ZEMU_GDB_DISCONNECTED;
+                        continue;
+                    }
+                }
+                else if (strncmp(packet, "vKill", 5) == 0)
+                {
+                    gdb_send(connection, "OK");
+                    return ZEMU_GDB_KILLED;
+                }
+                break;
+
+            case 'Z':
+            case 'z':
+                response = gdb_breakpoint(instance, p, packet[0] == 'Z');
+                break;
+
+            case 'q':
+                if (strncmp(packet, "qSupported", 10) == 0)
+                {
+                    snprintf(reply, sizeof(reply), "PacketSize=%x;QStartNoAckMode+;vContSupported+", ZEMU_GDB_PACKET_SIZE);
+                }
+                else if (strcmp(packet, "qAttached") == 0)
+                {
+                    response = "1";
+                }
+                else if (strcmp(packet, "qC") == 0)
+                {
+                    response = "QC1";
+                }
+                else if (strcmp(packet, "qfThreadInfo") == 0)
+                {
+                    response = "m1";
+                }
+                else if (strcmp(packet, "qsThreadInfo") == 0)
+                {
+                    response = "l";
+                }
+                else if (strcmp(packet, "qOffsets") == 0)
+                {
+                    response = "Text=0;Data=0;Bss=0";
+                }
+                break;
+
+            case 'Q':
+                if (strcmp(packet, "QStartNoAckMode") == 0)
+                {
+                    if (!gdb_send(connection, "OK")) return ZEMU_GDB_DISCONNECTED;
+                    connection->ack = FALSE;
+                    continue;
+                }
+                break;
+
+            case 'H':
+            case 'T':
+                /* There is a single thread. */
+                response = "OK";
+                break;
+
+            case 'D':
+                gdb_send(connection, "OK");
+                return ZEMU_GDB_DETACHED;
+
+            case 'k':
+                return ZEMU_GDB_KILLED;
+
+            default:
+                /* An empty reply indicates an unsupported packet. */
+                break;
+        }
+
+        if (!gdb_send(connection, response)) return ZEMU_GDB_DISCONNECTED;
+    }
+
+    return ZEMU_GDB_DISCONNECTED;
+}
+
+/* Listens on the given address, which is either the path of a Unix socket
+ * (if it contains a '/'), or a TCP port as "<port>" or "<host>:<port>".
+ * TCP connections are accepted only on localhost unless a host is given.
+ *
+ * Returns the listening socket, or -1 on failure.
+ */
+static int gdb_listen(const char * address)
+{
+    int listener;
+
+    if (strchr(address, '/') != NULL)
+    {
+        struct sockaddr_un local;
+        memset(&local, 0, sizeof(local));
+        local.sun_family = AF_UNIX;
+
+        if (strlen(address) >= sizeof(local.sun_path)) return -1;
+        strcpy(local.sun_path, address);
+
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0) return -1;
+
+        unlink(address);
+        if (bind(listener, (struct sockaddr *)&local, sizeof(local)) < 0 || listen(listener, 1) < 0)
+        {
+            close(listener);
+            return -1;
+        }
+
+        return listener;
+    }
+
+    char host[256] = "127.0.0.1";
+    const char * port = address;
+    const char * separator = strrchr(address, ':');
+
+    if (separator != NULL)
+    {
+        zusize length = (zusize)(separator - address);
+        if (length >= sizeof(host)) return -1;
+
+        if (length > 0)
+        {
+            memcpy(host, address, length);
+            host[length] = '\0';
+        }
+        port = separator + 1;
+    }
+
+    struct addrinfo hints;
+    struct addrinfo * addresses;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    if (getaddrinfo(host, port, &hints, &addresses) != 0) return -1;
+
+    listener = -1;
+    for (struct addrinfo * a = addresses; a != NULL; a = a->ai_next)
+    {
+        listener = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (listener < 0) continue;
+
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        if (bind(listener, a->ai_addr, a->ai_addrlen) == 0 && listen(listener, 1) == 0) break;
+
+        close(listener);
+        listener = -1;
+    }
+
+    freeaddrinfo(addresses);
+
+    return listener;
+}
+
+/* Waits for a debugger to connect at the given address (see gdb_listen),
+ * then serves GDB remote serial protocol requests until it detaches.
+ *
+ * Execution, breakpoints and memory access all take place natively.
+ *
+ * Returns one of the ZEMU_GDB_* reasons.
+ */
+zint32 zemu_gdb_serve(Z80 * instance, const char * address)
+{
+    static ZemuGDBConnection connection;
+
+    int listener = gdb_listen(address);
+    if (listener < 0) return ZEMU_GDB_ERROR;
+
+    int fd = accept(listener, NULL, NULL);
+    close(listener);
+    if (strchr(address, '/') != NULL) unlink(address);
+
+    if (fd < 0) return ZEMU_GDB_ERROR;
+
+    int option = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &option, sizeof(option));
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &option, sizeof(option));
+#endif
+
+    connection.fd = fd;
+    connection.ack = TRUE;
+    connection.input_position = 0;
+    connection.input_length = 0;
+
+    zint32 result = gdb_session(&connection, instance);
+
+    close(fd);
+
+    return result;
+}
@@ -0,0 +1,20 @@
+#ifndef _ZEMU_GDB_H
+#define _ZEMU_GDB_H
+
+#include "emulation/CPU/Z80.h"
+
+/* Reasons for which zemu_gdb_serve returns. */
+#define ZEMU_GDB_ERROR          -1  /* Could not listen on or accept a connection at the address. */
+#define ZEMU_GDB_DETACHED       0   /* The debugger detached. */
+#define ZEMU_GDB_KILLED         1   /* The debugger killed the target. */
+#define ZEMU_GDB_DISCONNECTED   2   /* The connection was closed. */
+
+/* Maximum size of a packet, excluding framing. */
+#define ZEMU_GDB_PACKET_SIZE    0x4000
+
+/* Number of cycles executed between checks for an interrupt from the debugger. */
+#define ZEMU_GDB_SLICE          100000
+
+zint32 zemu_gdb_serve(Z80 * instance, const char * address);
+
+#endif
@@ -0,0 +1,16 @@
+#include "link.h"
+
+#include <string.h>
+
+/* Returns the size of a link, so that the host can allocate memory for one. */
+zusize zemu_link_size(void)
+{
+    return sizeof(ZemuLink);
+}
+
+/* Initializes a link with the given latency in cycles, with no bytes in transit. */
+void zemu_link_init(ZemuLink * link, zuint64 latency)
+{
+    memset(link, 0, sizeof(ZemuLink));
+    link->latency = (latency > 0) ? latency : 1;
+}
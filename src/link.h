@@ -0,0 +1,96 @@
+#ifndef _ZEMU_LINK_H
+#define _ZEMU_LINK_H
+
+#include "emulation/CPU/Z80.h"
+
+/* A serial link between two emulated machines, each of which is one side of the link.
+ *
+ * The machines may be built from different libraries and run on different threads,
+ * so the link lives in memory shared by both, and is only accessed through the
+ * inline functions below, of which each library has its own copy.
+ */
+
+/* Maximum number of bytes in transit in each direction. */
+#define ZEMU_LINK_SIZE 1024
+
+/* A byte in transit, and the cycle of the receiving machine at which it is delivered. */
+typedef struct {
+    zuint64 time;
+    zuint8 value;
+} ZemuLinkMessage;
+
+/* A ring buffer of bytes in transit to one side, with a single producer and a single consumer. */
+typedef struct {
+    ZemuLinkMessage messages[ZEMU_LINK_SIZE];
+    unsigned int head;
+    unsigned int tail;
+} ZemuLinkChannel;
+
+typedef struct {
+    /* Cycles between a byte being sent and it being delivered. At least 1. */
+    zuint64 latency;
+
+    /* Bytes in transit to each side. */
+    ZemuLinkChannel channels[2];
+
+    /* Cycle reached by each side, and whether each side is active.
+     * A side may run ahead of an active side by at most the latency, as any byte
+     * it could receive before then has already been sent. A side is inactive
+     * once it has halted or been detached, and then does not hold up the other.
+     */
+    zuint64 time[2];
+    zuint8 active[2];
+} ZemuLink;
+
+/* Sends a byte from the given side, to be delivered after the latency of the link.
+ * The byte is lost if too many bytes are in transit.
+ */
+static inline void zemu_link_send(ZemuLink * link, zuint8 side, zuint8 value, zuint64 now)
+{
+    ZemuLinkChannel * c = &link->channels[1 - side];
+
+    unsigned int tail = c->tail;
+    unsigned int next = (tail + 1) % ZEMU_LINK_SIZE;
+
+    if (next == __atomic_load_n(&c->head, __ATOMIC_ACQUIRE)) return;
+
+    c->messages[tail].time = now + link->latency;
+    c->messages[tail].value = value;
+    __atomic_store_n(&c->tail, next, __ATOMIC_RELEASE);
+}
+
+/* Removes the next byte sent to the given side, if it is due by the given cycle.
+ * Returns TRUE if a byte was received.
+ */
+static inline zboolean zemu_link_receive(ZemuLink * link, zuint8 side, zuint64 now, zuint8 * value)
+{
+    ZemuLinkChannel * c = &link->channels[side];
+
+    unsigned int head = c->head;
+
+    if (head == __atomic_load_n(&c->tail, __ATOMIC_ACQUIRE)) return FALSE;
+    if (c->messages[head].time > now) return FALSE;
+
+    *value = c->messages[head].value;
+    __atomic_store_n(&c->head, (head + 1) % ZEMU_LINK_SIZE, __ATOMIC_RELEASE);
+    return TRUE;
+}
+
+/* Publishes the cycle reached by the given side, and whether it is active. */
+static inline void zemu_link_publish(ZemuLink * link, zuint8 side, zuint64 now, zboolean active)
+{
+    __atomic_store_n(&link->time[side], now, __ATOMIC_RELEASE);
+    __atomic_store_n(&link->active[side], active ? 1 : 0, __ATOMIC_RELEASE);
+}
+
+/* Returns the cycle up to which the given side may run without waiting for the other side. */
+static inline zuint64 zemu_link_bound(ZemuLink * link, zuint8 side)
+{
+    if (!__atomic_load_n(&link->active[1 - side], __ATOMIC_ACQUIRE)) return (zuint64)-1;
+    return __atomic_load_n(&link->time[1 - side], __ATOMIC_ACQUIRE) + link->latency;
+}
+
+zusize zemu_link_size(void);
+void zemu_link_init(ZemuLink * link, zuint64 latency);
+
+#endif
@@ -2,11 +2,14 @@
 
 #include "emulation/CPU/Z80.h"
 
+#include "zemu.h"
 #include "debug.h"
 
 #include "memory.h"
 #include "io.h"
 #include "interrupt.h"
+#include "cpu.h"
+#include "fuzz.h"
 
 /* Allocate and initialize a Z80 instance.
  * Return a pointer to the instance so that it can be used
@@ -44,26 +47,42 @@ Z80 * zemu_init(void)
      */
     instance->halt = zemu_debug_halt;
 
+    /* Allocate any other CPUs of the machine.
+     * These are autogenerated in cpu.c/cpu.h.
+     */
+    zemu_cpu_init(instance);
+
+    /* Clear breakpoints and state left by any previous instance. */
+    zemu_debug_init();
+
     /* Return the now-initialized instance. */
     return instance;
 }
 
 void zemu_free(Z80 * instance)
 {
+    zemu_fuzz_end();
+    zemu_cpu_free();
     free(instance);
 }
 
 void zemu_power_on(Z80 * instance)
 {
     z80_power(instance, TRUE);
+    zemu_cpu_power(TRUE);
 }
 
 void zemu_power_off(Z80 * instance)
 {
     z80_power(instance, FALSE);
+    zemu_cpu_power(FALSE);
 }
 
 void zemu_reset(Z80 * instance)
 {
     z80_reset(instance);
+    zemu_cpu_reset();
+
+    /* The CPU leaves the HALT state on reset. */
+    zemu_debug_halt(instance->context, FALSE);
 }
@@ -0,0 +1,190 @@
+#ifndef _ZEMU_H
+#define _ZEMU_H
+
+/* Public API of a Zemu emulator library.
+ *
+ * This header declares the functions which a host, such as Zemu::Instance or a C or C++
+ * test harness, uses to drive an emulator built by Zemu::build. It does not depend on the
+ * sources generated for a configuration, so the same header serves every configuration.
+ *
+ * To build against it, add src, src/external/Z/API and src/external/z80/API to the
+ * include path, and link the shared library or the static archive built when the
+ * build_static parameter of the configuration is set.
+ *
+ * All emulator state is global to the library: a library (or archive) drives a single
+ * instance at a time, and one archive per configuration can be linked into a program.
+ * Functions must not be called concurrently, except those noted as thread-safe.
+ */
+
+#include "emulation/CPU/Z80.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "disassemble.h"
+#include "fuzz.h"
+#include "link.h"
+
+/* Version of this API. Incremented on incompatible changes. */
+#define ZEMU_API_VERSION                1
+
+/* The full state of the CPU, for reading and writing in bulk. */
+typedef struct {
+    zuint16 pc, sp;
+    zuint16 af, bc, de, hl, ix, iy;
+    zuint16 af_, bc_, de_, hl_;
+    zuint8 i, r;
+    zuint8 iff1, iff2, im;
+    zuint8 halted;
+} ZemuState;
+
+/* Reasons for which zemu_debug_continue returns.
+ * These correspond to the states in Zemu::Instance::RunState.
+ */
+#define ZEMU_DEBUG_STATE_RUNNING        0   /* Executed the requested number of cycles. */
+#define ZEMU_DEBUG_STATE_HALTED         1   /* Executed a HALT instruction. */
+#define ZEMU_DEBUG_STATE_BREAK          2   /* Hit a breakpoint. */
+#define ZEMU_DEBUG_STATE_INTERRUPTED    3   /* Stopped by zemu_debug_stop, or by SIGINT. */
+#define ZEMU_DEBUG_STATE_WATCHPOINT     4   /* Accessed memory at a watchpoint. */
+#define ZEMU_DEBUG_STATE_REACHED        5   /* Reached the target of a step over, step out, run to or run until output. */
+#define ZEMU_DEBUG_STATE_TIMEOUT        6   /* Exceeded a limit set by zemu_debug_set_watchdog. */
+
+/* Types of memory access for watchpoints. */
+#define ZEMU_DEBUG_WATCH_READ           0x01
+#define ZEMU_DEBUG_WATCH_WRITE          0x02
+
+/* Instance lifecycle.
+ * zemu_init allocates the instance and clears all breakpoints and debugging state.
+ * An instance must be powered on and reset before it is run.
+ */
+Z80 * zemu_init(void);
+void zemu_free(Z80 * instance);
+void zemu_power_on(Z80 * instance);
+void zemu_power_off(Z80 * instance);
+void zemu_reset(Z80 * instance);
+
+/* Running.
+ * zemu_debug_step executes one instruction and returns the number of cycles taken.
+ * The other functions run until a stop condition (see zemu_debug_state) or until run_cycles
+ * cycles have been executed (-1 for no limit), and return the number of cycles executed.
+ */
+zusize zemu_debug_step(Z80 * instance);
+zuint64 zemu_debug_continue(Z80 * instance, zint64 run_cycles);
+zuint64 zemu_debug_step_over(Z80 * instance, zint64 run_cycles);
+zuint64 zemu_debug_step_out(Z80 * instance, zint64 run_cycles);
+zuint64 zemu_debug_run_to(Z80 * instance, zuint16 address, zint64 run_cycles);
+zuint64 zemu_debug_call(Z80 * instance, zuint16 address, const zuint16 * arguments, zusize count, zuint16 sentinel, zint64 run_cycles);
+zuint64 zemu_debug_run_until_output(Z80 * instance, const zuint8 * pattern, zusize length, zint64 run_cycles);
+
+/* Reason for which the last run returned, one of ZEMU_DEBUG_STATE_*, and the PC at which it stopped. */
+zint32 zemu_debug_state(void);
+zuint16 zemu_debug_stop_pc(void);
+
+/* Requests that a run stops. Thread-safe. */
+void zemu_debug_stop(void);
+
+/* Settings for subsequent runs: pacing to a clock speed in Hz (0 to run as fast as possible),
+ * stopping on SIGINT, and limits on cycles, instructions and host time in nanoseconds (0 for no limit).
+ */
+void zemu_debug_set_pacing(zuint64 clock_speed);
+void zemu_debug_set_interruptible(zboolean interruptible);
+void zemu_debug_set_watchdog(zuint64 cycles, zuint64 instructions, zuint64 nanoseconds);
+
+/* Running in a background thread. See async.c. */
+zboolean zemu_async_start(Z80 * instance, zint64 run_cycles);
+void zemu_async_pause(void);
+zboolean zemu_async_wait(zint64 timeout_ms);
+zboolean zemu_async_running(void);
+int zemu_async_fd(void);
+
+/* Breakpoints and watchpoints.
+ * A condition is bytecode compiled by Zemu::Debug::Condition. See condition.h.
+ */
+void zemu_debug_set_breakpoint(zuint16 address, zboolean set);
+zboolean zemu_debug_set_condition(zuint16 address, const zuint8 * code, zusize length);
+void zemu_debug_set_watchpoint(Z80 * instance, zuint16 address, zuint8 type, zboolean set);
+zuint16 zemu_debug_watch_address(void);
+zuint8 zemu_debug_watch_type(void);
+void zemu_debug_clear(Z80 * instance);
+
+/* Registers, numbered as in Zemu::Instance::REGISTERS, and CPU state. */
+zuint16 zemu_debug_register(Z80 * instance, zuint16 r);
+void zemu_debug_set_register(Z80 * instance, zuint16 r, zuint16 value);
+zuint16 zemu_debug_pc(Z80 * instance);
+void zemu_debug_get_state(Z80 * instance, ZemuState * out);
+void zemu_debug_set_state(Z80 * instance, const ZemuState * in);
+zboolean zemu_debug_halted(void);
+void zemu_debug_set_halted(Z80 * instance, zboolean state);
+
+/* Memory, as seen by the primary CPU, or by the CPU with the given index.
+ * Writes to read-only memory are ignored.
+ */
+zuint8 zemu_memory_peek(zuint16 address);
+zuint8 zemu_debug_get_memory(zuint16 address);
+zuint8 zemu_memory_peek_cpu(zusize cpu, zuint16 address);
+void zemu_memory_peek_block(zuint16 address, zusize size, zuint8 * buffer);
+zusize zemu_memory_poke_block(zuint16 address, zusize size, const zuint8 * buffer);
+
+/* Snapshots of memory: the contents of every writable memory block. */
+zusize zemu_memory_snapshot_size(void);
+void zemu_memory_save(zuint8 * buffer);
+void zemu_memory_restore(const zuint8 * buffer);
+
+/* Counts of accesses to each 256-byte page of memory, kept if the library is built with
+ * ZEMU_MEMORY_HEATMAP defined (by the heatmap parameter of the configuration).
+ * zemu_memory_heatmap copies 3 x 0x100 counters, indexed by ZEMU_MEMORY_HEAT_* and page.
+ */
+#define ZEMU_MEMORY_HEAT_READ           0
+#define ZEMU_MEMORY_HEAT_WRITE          1
+#define ZEMU_MEMORY_HEAT_FETCH          2
+
+zboolean zemu_memory_heatmap(zuint64 * buffer);
+void zemu_memory_heatmap_clear(void);
+
+/* The CPU with the given index, or NULL. CPU 0 is the instance returned by zemu_init. */
+Z80 * zemu_cpu(zusize index);
+
+/* IO devices.
+ * Each device also has functions named after it, declared by its when_setup block,
+ * such as zemu_io_<name>_master_puts for a serial port.
+ */
+zuint8 zemu_io_in(void * context, zuint16 port);
+void zemu_io_out(void * context, zuint16 port, zuint8 value);
+void zemu_io_nmi(Z80 * instance);
+void zemu_io_int_on(Z80 * instance);
+void zemu_io_int_off(Z80 * instance);
+
+/* Serial links to other emulators. See link.h. */
+zusize zemu_link_size(void);
+void zemu_link_init(ZemuLink * link, zuint64 latency);
+
+/* Statistics.
+ * zemu_debug_cycles is the number of cycles executed by runs, and is thread-safe.
+ * zemu_debug_now is the number of cycles executed since initialization, including single steps.
+ * zemu_debug_hits is the number of times the breakpoint at an address has been reached.
+ */
+zuint64 zemu_debug_cycles(void);
+zuint64 zemu_debug_now(void);
+zuint64 zemu_debug_hits(zuint16 address);
+
+/* Serves GDB remote serial protocol requests. See gdb.h. */
+zint32 zemu_gdb_serve(Z80 * instance, const char * address);
+
+/* Disassembly. See disassemble.h. */
+zusize zemu_disassemble(zuint16 address, zusize count, ZemuInstruction * instructions);
+
+/* Fuzzing, with edge coverage of the emulated program. See fuzz.c.
+ * zemu_fuzz_setup snapshots the machine, and zemu_fuzz_one runs an input from the snapshot.
+ */
+zboolean zemu_fuzz_setup(const char * serial, zint64 run_cycles);
+zuint64 zemu_fuzz_one(Z80 * instance, const zuint8 * data, zusize size);
+zusize zemu_fuzz_edges(void);
+void zemu_fuzz_coverage(zuint8 * buffer);
+void zemu_fuzz_end(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -26,7 +26,243 @@ module Build
 
             assert result
 
-            assert File.exist?(File.join(BIN, "zemu.so"))
+            assert File.exist?(File.join(BIN, "zemu_release.so"))
+        end
+
+        # Libraries built with different build profiles can exist side-by-side.
+        def test_build_profiles
+            confs = [:release, :debug].map do |profile|
+                Zemu::Config.new do
+                    name "zemu_profiles"
+
+                    output_directory BIN
+                    build_profile profile
+
+                    add_memory (Zemu::Config::ROM.new do
+                        name "rom"
+                        address 0x0000
+                        size 0x1000
+                    end)
+                end
+            end
+
+            confs.each { |c| assert Zemu.build(c) }
+
+            assert File.exist?(File.join(BIN, "zemu_profiles_release.so"))
+            assert File.exist?(File.join(BIN, "zemu_profiles_debug.so"))
+        end
+
+        # A static archive can be built, and linked by a C host through zemu.h.
+        def test_build_static
+            conf = Zemu::Config.new do
+                name "zemu_static"
+
+                output_directory BIN
+                build_static true
+
+                add_memory (Zemu::Config::ROM.new do
+                    name "rom"
+                    address 0x0000
+                    size 0x1000
+
+                    # 3 NOPs and then a HALT
+                    contents [0x00, 0x00, 0x00, 0x76]
+                end)
+            end
+
+            assert Zemu.build(conf)
+            assert File.exist?(File.join(BIN, "zemu_static_release.a"))
+
+            host = File.join(BIN, "zemu_static_host.c")
+            File.write(host, <<~C)
+                #include "zemu.h"
+
+                int main(void)
+                {
+                    Z80 * instance = zemu_init();
+                    zemu_power_on(instance);
+                    zemu_reset(instance);
+                    zemu_debug_continue(instance, -1);
+                    return (zemu_debug_state() == ZEMU_DEBUG_STATE_HALTED) ? 0 : 1;
+                }
+            C
+
+            includes = ["", "external/Z/API", "external/z80/API"].map { |i| "-I" + File.join(Zemu::SRC, i) }.join(" ")
+            executable = File.join(BIN, "zemu_static_host")
+
+            assert system("#{conf.compiler} #{includes} -o #{executable} #{host} #{conf.archive} -pthread")
+            assert system(executable)
+        end
+
+        # We should be able to build a library using profile-guided optimisation,
+        # and the profile should be reused by a subsequent build.
+        def test_profile_guided
+            conf = Zemu::Config.new do
+                name "zemu_pgo"
+
+                output_directory BIN
+
+                add_memory (Zemu::Config::ROM.new do
+                    name "rom"
+                    address 0x0000
+                    size 0x1000
+
+                    # 3 NOPs and then a HALT
+                    contents [0x00, 0x00, 0x00, 0x76]
+                end)
+            end
+
+            assert Zemu.build(conf, pgo: 1000)
+
+            profile = File.join(BIN, "pgo_zemu_pgo_release", "zemu_pgo.profdata")
+            assert File.exist?(profile)
+
+            mtime = File.mtime(profile)
+
+            assert Zemu.build(conf, pgo: 1000)
+            assert_equal mtime, File.mtime(profile)
+
+            # A different workload gathers a new profile.
+            digest_path = File.join(BIN, "pgo_zemu_pgo_release", "zemu_pgo.digest")
+            digest = File.read(digest_path)
+
+            assert Zemu.build(conf, pgo: ->(instance) { instance.continue(2000) }, pgo_key: "2000")
+            refute_equal digest, File.read(digest_path)
+        end
+
+        # Profile-guided optimisation needs clang, and says so rather than running another tool.
+        def test_profile_guided_compiler
+            conf = Zemu::Config.new do
+                name "zemu_pgo_gcc"
+
+                output_directory BIN
+
+                compiler "gcc"
+            end
+
+            e = assert_raises(ArgumentError) { Zemu.build(conf, pgo: 1000) }
+            assert_equal "Profile-guided optimisation requires the clang compiler, not gcc.", e.message
+        end
+
+        # We should be able to build a library with the blocks of code in ROM found ahead of time,
+        # which runs the same program with the same result.
+        def test_batch_blocks
+            conf = Zemu::Config.new do
+                name "zemu_batch_blocks"
+
+                output_directory BIN
+
+                batch_blocks true
+
+                add_memory (Zemu::Config::ROM.new do
+                    name "rom"
+                    address 0x0000
+                    size 0x1000
+
+                    contents [
+                        0x06, 0x10,         # 0x0000: LD B, 0x10
+                        0x3e, 0x00,         # 0x0002: LD A, 0x00
+                        0x3c,               # 0x0004: INC A
+                        0x00,               # 0x0005: NOP
+                        0x10, 0xfc,         # 0x0006: DJNZ 0x0004
+                        0x32, 0x00, 0x80,   # 0x0008: LD (0x8000), A
+                        0x76                # 0x000b: HALT
+                    ]
+                end)
+
+                add_memory (Zemu::Config::RAM.new do
+                    name "ram"
+                    address 0x8000
+                    size 0x100
+                end)
+            end
+
+            assert Zemu.build(conf)
+
+            blocks = File.read(File.join(BIN, "autogen_zemu_batch_blocks", "blocks.c"))
+            assert_includes blocks, "[0x04] = { 8, 3 }"
+
+            instance = Zemu::Instance.new(conf)
+            instance.continue(1000)
+
+            assert instance.halted?
+            assert_equal 0x10, instance.memory(0x8000)
+
+            instance.quit
+
+            # Single steps run one instruction at a time, even at the start of a block.
+            instance = Zemu::Instance.new(conf)
+
+            [0x0002, 0x0004, 0x0005, 0x0006].each do |pc|
+                instance.continue(1)
+                assert_equal pc, instance.registers["PC"]
+            end
+
+            instance.quit
+        end
+
+        # We should be able to build a libFuzzer target which feeds inputs to a serial port.
+        def test_fuzzer
+            conf = Zemu::Config.new do
+                name "zemu_fuzzer"
+
+                output_directory BIN
+
+                add_memory (Zemu::Config::ROM.new do
+                    name "rom"
+                    address 0x0000
+                    size 0x1000
+
+                    # Echoes the serial port.
+                    contents [0xdb, 0x00, 0xd3, 0x01, 0x18, 0xfa]
+                end)
+
+                add_io (Zemu::Config::SerialPort.new do
+                    name "serial"
+                    in_port 0x00
+                    out_port 0x01
+                    ready_port 0x02
+                end)
+            end
+
+            assert_raises ArgumentError do
+                Zemu.build_fuzzer(conf, serial: "nonexistent")
+            end
+
+            assert Zemu.build_fuzzer(conf, serial: "serial", cycles: 1000)
+            assert File.exist?(conf.fuzzer)
+
+            assert system(conf.fuzzer, "-runs=100", out: File::NULL, err: File::NULL)
+        end
+
+        # Several processes can build the same configuration at the same time.
+        def test_concurrent
+            conf = Zemu::Config.new do
+                name "zemu_concurrent"
+
+                output_directory BIN
+                build_jobs 2
+
+                add_memory (Zemu::Config::ROM.new do
+                    name "rom"
+                    address 0x0000
+                    size 0x1000
+                end)
+            end
+
+            FileUtils.rm_f conf.library
+
+            pids = 4.times.map do
+                fork { exit(Zemu.build(conf) ? 0 : 1) }
+            end
+
+            pids.each do |pid|
+                Process.wait(pid)
+                assert $?.success?
+            end
+
+            assert File.exist?(conf.library)
+            assert_empty Dir.glob(File.join(BIN, "*.tmp"))
         end
     end
 end
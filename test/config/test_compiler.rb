@@ -76,5 +76,61 @@ module Config
 
             assert_equal "some/directory", conf.output_directory
         end
+
+        # The default build profile is release.
+        def test_default_build_profile
+            conf = Zemu::Config.new do
+                name "my_config"
+            end
+
+            assert_equal :release, conf.build_profile
+            assert_equal ["-O2"], conf.compiler_flags
+            assert_equal "my_config_release.so", conf.library_name
+        end
+
+        # We can select a build profile, by symbol or by string.
+        def test_set_build_profile
+            conf = Zemu::Config.new do
+                name "my_config"
+                build_profile "native"
+            end
+
+            assert_equal :native, conf.build_profile
+            assert_includes conf.compiler_flags, "-march=native"
+            assert_equal File.join("bin", "my_config_native.so"), conf.library
+        end
+
+        # An exception is raised if the build profile is not known.
+        def test_invalid_build_profile
+            e = assert_raises Zemu::ConfigError do
+                _ = Zemu::Config.new do
+                    name "my_config"
+                    build_profile :fastest
+                end
+            end
+
+            assert_equal "The build_profile parameter of a Zemu::Config configuration object must be one of: release, native, profile, debug.", e.message
+        end
+
+        # Extra flags are passed to the compiler after those of the build profile.
+        def test_extra_flags
+            conf = Zemu::Config.new do
+                name "my_config"
+                build_profile :debug
+                extra_flags ["-fsanitize=address"]
+            end
+
+            assert_equal "-fsanitize=address", conf.compiler_flags.last
+            assert_includes conf.compiler_flags, "-g"
+        end
+
+        # By default, the emulator is built using as many jobs as there are processors.
+        def test_default_build_jobs
+            conf = Zemu::Config.new do
+                name "my_config"
+            end
+
+            assert_equal Etc.nprocessors, conf.build_jobs
+        end
     end
-end
\ No newline at end of file
+end
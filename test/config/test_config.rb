@@ -51,5 +51,95 @@ module Config
 
             assert_equal 0.025, conf.serial_delay
         end
+
+        # A configuration without CPUs has a single primary CPU.
+        def test_default_cpu
+            conf = Zemu::Config.new do
+                name "my_config"
+                clock_speed 1_000_000
+            end
+
+            assert_equal ["main"], conf.cpus.map(&:name)
+            assert_equal [1.0], conf.cpu_rates
+        end
+
+        # CPUs are run at rates relative to the primary CPU, given by their clock speeds.
+        def test_cpu_rates
+            conf = Zemu::Config.new do
+                name "my_config"
+                clock_speed 4_000_000
+
+                add_cpu (Zemu::Config::CPU.new do
+                    name "main"
+                end)
+
+                add_cpu (Zemu::Config::CPU.new do
+                    name "sound"
+                    clock_speed 2_000_000
+                end)
+            end
+
+            assert_equal ["main", "sound"], conf.cpus.map(&:name)
+            assert_equal [1.0, 0.5], conf.cpu_rates
+            assert_equal 1, conf.cpu_index("sound")
+        end
+
+        # Memory can only be restricted to CPUs which are part of the configuration.
+        def test_unknown_cpu
+            e = assert_raises Zemu::ConfigError do
+                Zemu::Config.new do
+                    name "my_config"
+
+                    add_memory (Zemu::Config::RAM.new do
+                        name "ram"
+                        address 0x8000
+                        size 0x1000
+                        cpus ["sound"]
+                    end)
+                end
+            end
+
+            assert_equal "The ram Zemu::Config::RAM configuration object uses unknown CPUs: sound.", e.message
+        end
+
+        # Entry points for the analysis of code in ROM must be addresses.
+        def test_entry_points
+            e = assert_raises Zemu::ConfigError do
+                Zemu::Config.new do
+                    name "my_config"
+                    batch_blocks true
+                    entry_points [0x100, 0x10000]
+                end
+            end
+
+            assert_equal "The entry_points parameter of a Zemu::Config configuration object must contain 16-bit addresses.", e.message
+        end
+
+        # Pages within one memory block are accessed through the page table,
+        # and pages shared between blocks by searching the blocks.
+        def test_page_table
+            conf = Zemu::Config.new do
+                name "my_config"
+
+                add_memory (Zemu::Config::ROM.new do
+                    name "rom"
+                    address 0x0000
+                    size 0x180
+                end)
+
+                add_memory (Zemu::Config::RAM.new do
+                    name "ram"
+                    address 0x0180
+                    size 0x180
+                end)
+            end
+
+            reads = conf.page_table(0).split(/,\s*/)
+            writes = conf.page_table(0, write: true).split(/,\s*/)
+
+            assert_equal 0x100, reads.size
+            assert_equal ["zemu_memory_block_rom + 0x0", "NULL", "zemu_memory_block_ram + 0x80", "zemu_memory_unmapped"], reads[0, 4]
+            assert_equal ["NULL", "NULL", "zemu_memory_block_ram + 0x80", "NULL"], writes[0, 4]
+        end
     end
 end
\ No newline at end of file
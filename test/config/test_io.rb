@@ -42,5 +42,19 @@ module Config
             assert_equal 0x00, timer.count_port
             assert_equal 0x01, timer.control_port
         end
+
+        # A mailbox must connect exactly two CPUs.
+        def test_mailbox_cpus
+            e = assert_raises Zemu::ConfigError do
+                _ = Zemu::Config::Mailbox.new do
+                    name "mailbox"
+                    cpus ["main"]
+                    data_port 0x10
+                    status_port 0x11
+                end
+            end
+
+            assert_equal "The cpus parameter of a Zemu::Config::Mailbox configuration object must name two CPUs.", e.message
+        end
     end
 end
@@ -76,7 +76,7 @@ module Config
             end
 
             assert_equal 0x1000, mem.contents.size
-            mem.contents.each do |b|
+            mem.contents.each_byte do |b|
                 assert_equal 0x00, b
             end
         end
@@ -92,8 +92,8 @@ module Config
             end
 
             assert_equal 0x1000, mem.contents.size
-            assert_equal [0, 255, 100, 20, 42, 1, 254], mem.contents[0..6]
-            mem.contents[7..-1].each do |b|
+            assert_equal [0, 255, 100, 20, 42, 1, 254], mem.contents.bytes[0..6]
+            mem.contents.bytes[7..-1].each do |b|
                 assert_equal 0x00, b
             end
         end
@@ -118,10 +118,60 @@ module Config
             end
 
             assert_equal 0x1000, mem.contents.size
-            assert_equal [0x01, 0xaa, 0x12, 0x42, 0xde], mem.contents[0..4]
-            mem.contents[5..-1].each do |b|
+            assert_equal [0x01, 0xaa, 0x12, 0x42, 0xde], mem.contents.bytes[0..4]
+            mem.contents.bytes[5..-1].each do |b|
                 assert_equal 0x00, b
             end
         end
+
+        # A ROM object can be initialized with a binary string.
+        def test_initial_val_set_string
+            mem = Zemu::Config::ROM.new do
+                name "my_rom"
+                address 0x8000
+                size 0x1000
+
+                contents "\x01\x02\x00\xff"
+            end
+
+            assert_equal Encoding::BINARY, mem.contents.encoding
+            assert_equal 0x1000, mem.contents.size
+            assert_equal [0x01, 0x02, 0x00, 0xff, 0x00], mem.contents.bytes[0..4]
+        end
+
+        # A memory object with no contents is entirely zero.
+        def test_zero
+            ram = Zemu::Config::RAM.new do
+                name "my_ram"
+                address 0x8000
+                size 0x1000
+            end
+
+            rom = Zemu::Config::ROM.new do
+                name "my_rom"
+                address 0x0000
+                size 0x1000
+
+                contents [0x00, 0x00, 0x01]
+            end
+
+            assert ram.zero?
+            refute rom.zero?
+        end
+
+        # The C initializer for a memory object omits trailing zero bytes.
+        def test_initializer
+            mem = Zemu::Config::ROM.new do
+                name "my_rom"
+                address 0x0000
+                size 0x1000
+
+                contents ([0xaa] * 16) + [0x00, 0x01]
+            end
+
+            expected = "\n    " + ("0xaa, " * 16) + "\n    0x00, 0x01, "
+
+            assert_equal expected, mem.initializer
+        end
     end
-end
\ No newline at end of file
+end
@@ -0,0 +1,45 @@
+require 'minitest/autorun'
+require 'zemu'
+
+# Tests the compilation of breakpoint conditions.
+class ConditionTest < Minitest::Test
+    # Returns the bytecode for pushing a constant.
+    def constant(value)
+        return "\x01".b + [value].pack("Q<")
+    end
+
+    def test_comparison
+        condition = Zemu::Debug::Condition.new("A == 0x42")
+
+        assert_equal "A == 0x42", condition.expression
+        assert_equal "\x02\x04".b + constant(0x42) + "\x27\x00".b, condition.bytecode
+    end
+
+    def test_memory
+        # (HL) is the byte in memory at HL, which is (H << 8) | L.
+        condition = Zemu::Debug::Condition.new("(HL) != $10")
+
+        hl = "\x02\x0a".b + constant(8) + "\x25\x02\x0b\x23".b
+        assert_equal hl + "\x03".b + constant(0x10) + "\x28\x00".b, condition.bytecode
+    end
+
+    def test_precedence
+        # && binds more tightly than ||, and [] groups.
+        a = Zemu::Debug::Condition.new("hits == 1 || cycles > 2 && A")
+        b = Zemu::Debug::Condition.new("hits == 1 || [cycles > 2 && A]")
+        c = Zemu::Debug::Condition.new("[hits == 1 || cycles > 2] && A")
+
+        assert_equal a.bytecode, b.bytecode
+        refute_equal a.bytecode, c.bytecode
+        assert_equal "\x2d\x00".b, c.bytecode[-2..-1]
+    end
+
+    def test_invalid
+        ["", "A ==", "(HL", "[A", "Q == 1", "A = 1", "1 2"].each do |e|
+            assert_raises(ArgumentError) { Zemu::Debug::Condition.new(e) }
+        end
+
+        # Too deep for the evaluation stack.
+        assert_raises(ArgumentError) { Zemu::Debug::Condition.new((["A"] * 40).join(" + [") + ("]" * 39)) }
+    end
+end
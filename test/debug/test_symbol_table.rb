@@ -0,0 +1,83 @@
+require 'minitest/autorun'
+require 'zemu'
+
+# Tests the functionality of the symbol table class.
+class SymbolTableTest < Minitest::Test
+    def setup
+        File.open("test.map", "w+") do |f|
+            f.puts "start = 0x0000"
+            f.puts "main = $0100"
+            f.puts "main_loop = 0x0108"
+            f.puts "alias = $0100"
+            f.puts "buffer = 0x8000"
+        end
+
+        @table = Zemu::Debug::SymbolTable.load_map("test.map")
+    end
+
+    def teardown
+        File.delete("test.map")
+    end
+
+    # Ensure that we can find the symbols at an exact address.
+    def test_exact
+        assert_equal 5, @table.size
+        assert_equal ["alias", "main"], @table[0x0100].map(&:label)
+        assert_equal [], @table[0x0101]
+    end
+
+    # Ensure that we find the nearest symbol at or before an address.
+    def test_lookup
+        sym, offset = @table.lookup(0x0100)
+        assert_equal "alias", sym.label
+        assert_equal 0, offset
+
+        sym, offset = @table.lookup(0x0110)
+        assert_equal "main_loop", sym.label
+        assert_equal 8, offset
+
+        sym, offset = @table.lookup(0xffff)
+        assert_equal "buffer", sym.label
+        assert_equal 0x7fff, offset
+
+        sym, offset = @table.lookup(0x0000)
+        assert_equal "start", sym.label
+        assert_equal 0, offset
+    end
+
+    # There is no symbol before the lowest symbol.
+    def test_lookup_none
+        table = Zemu::Debug::SymbolTable.new([Zemu::Debug::Symbol.new("sym", 0x1000)])
+        assert_nil table.lookup(0x0fff)
+        assert_nil Zemu::Debug::SymbolTable.new.lookup(0x1000)
+    end
+
+    # Ensure that we can find the address of a label.
+    def test_address_of
+        assert_equal 0x0108, @table.address_of("main_loop")
+        assert_nil @table.address_of("nonexistent")
+    end
+
+    # Merging a table with symbols already present does not duplicate them.
+    def test_merge
+        @table.merge! Zemu::Debug::SymbolTable.load_map("test.map")
+        assert_equal 5, @table.size
+    end
+
+    # A table can be serialized and loaded again.
+    def test_serialize
+        table = Zemu::Debug::SymbolTable.deserialize(@table.serialize)
+
+        assert_equal @table.to_a.map { |s| [s.label, s.address] }, table.to_a.map { |s| [s.label, s.address] }
+        assert_equal 0x8000, table.address_of("buffer")
+    end
+
+    # Deserializing anything other than a symbol table raises an error.
+    def test_deserialize_invalid
+        e = assert_raises ArgumentError do
+            Zemu::Debug::SymbolTable.deserialize("garbage")
+        end
+
+        assert_equal "Not a serialized symbol table.", e.message
+    end
+end
@@ -0,0 +1,91 @@
+require 'minitest/autorun'
+require 'zemu'
+
+class AsyncTest < Minitest::Test
+    BIN = File.join(__dir__, "..", "..", "bin")
+
+    def teardown
+        @instance.quit unless @instance.nil?
+    end
+
+    def test_pause
+        conf = Zemu::Config.new do
+            name "zemu_async_pause"
+
+            output_directory BIN
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+
+                contents [
+                    0x18, 0xfe          # 0x0000: JR 0x0000
+                ]
+            end)
+        end
+
+        @instance = Zemu.start(conf)
+
+        events = @instance.start_async
+        assert @instance.running?
+
+        # Only one run at a time.
+        assert_raises(RuntimeError) { @instance.start_async }
+        assert_raises(RuntimeError) { @instance.continue }
+
+        refute @instance.wait(0.05)
+        assert_nil IO.select([events], nil, nil, 0)
+        assert @instance.cycles > 0
+
+        @instance.pause
+
+        refute_nil IO.select([events], nil, nil, 5)
+        assert @instance.wait(5)
+
+        refute @instance.running?
+        assert @instance.interrupted?
+        assert_nil IO.select([events], nil, nil, 0)
+    end
+
+    def test_serial
+        conf = Zemu::Config.new do
+            name "zemu_async_serial"
+
+            output_directory BIN
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+
+                contents [
+                    0xdb, 0x02,         # 0x0000: IN A, (#0x02)
+                    0xb7,               # 0x0002: OR A
+                    0x28, 0xfb,         # 0x0003: JR Z, 0x0000
+                    0xdb, 0x00,         # 0x0005: IN A, (#0x00)
+                    0xd3, 0x01,         # 0x0007: OUT (#0x01), A
+                    0x76                # 0x0009: HALT
+                ]
+            end)
+
+            add_io (Zemu::Config::SerialPort.new do
+                name "serial"
+                in_port 0x00
+                out_port 0x01
+                ready_port 0x02
+            end)
+        end
+
+        @instance = Zemu.start(conf)
+
+        @instance.start_async
+
+        # The emulated machine echoes a character sent while it is running.
+        @instance.serial_puts "x"
+
+        assert @instance.wait(5)
+        assert @instance.halted?
+        assert_equal "x", @instance.serial_gets
+    end
+end
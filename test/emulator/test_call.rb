@@ -0,0 +1,79 @@
+require 'minitest/autorun'
+require 'zemu'
+
+class CallTest < Minitest::Test
+    BIN = File.join(__dir__, "..", "..", "bin")
+
+    def setup
+        conf = Zemu::Config.new do
+            name "zemu_call"
+
+            output_directory BIN
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+
+                contents [
+                    0x76,               # 0x0000: HALT
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                    0x19,               # 0x0010: add: ADD HL, DE
+                    0xc9,               # 0x0011:      RET
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                    0x21, 0x02, 0x00,   # 0x0020: arg: LD HL, #2
+                    0x39,               # 0x0023:      ADD HL, SP
+                    0x5e,               # 0x0024:      LD E, (HL)
+                    0x23,               # 0x0025:      INC HL
+                    0x56,               # 0x0026:      LD D, (HL)
+                    0xeb,               # 0x0027:      EX DE, HL
+                    0xc9,               # 0x0028:      RET
+                    0x18, 0xfe,         # 0x0029: loop: JR loop
+                ]
+            end)
+
+            add_memory (Zemu::Config::RAM.new do
+                name "ram"
+                address 0x2000
+                size 0x100
+            end)
+        end
+
+        @instance = Zemu.start(conf)
+    end
+
+    def teardown
+        @instance.quit unless @instance.nil?
+    end
+
+    def test_registers
+        symbols = Zemu::Debug::SymbolTable.new([Zemu::Debug::Symbol.new("add", 0x0010)])
+
+        registers, cycles = @instance.call("add", symbols: symbols, registers: { "SP" => 0x2100, "HL" => 1234, "DE" => 4321 })
+
+        assert_equal 5555, (registers["H"] << 8) | registers["L"]
+        assert_equal 0x2100, registers["SP"]
+        assert_equal 0xffff, registers["PC"]
+        assert cycles > 0
+
+        # Call again, from the state left by the first call.
+        registers, _ = @instance.call(0x0010)
+        assert_equal 9876, (registers["H"] << 8) | registers["L"]
+    end
+
+    def test_stack_args
+        registers, _ = @instance.call(0x0020, registers: { "SP" => 0x2100 }, stack_args: [0xbeef, 0x1234])
+
+        assert_equal 0xbeef, (registers["H"] << 8) | registers["L"]
+
+        # The arguments are popped.
+        assert_equal 0x2100, registers["SP"]
+    end
+
+    def test_no_return
+        assert_raises(RuntimeError) { @instance.call(0x0029, registers: { "SP" => 0x2100 }, max_cycles: 1000) }
+        assert_raises(ArgumentError) { @instance.call(0x0010, registers: { "Q" => 1 }) }
+    end
+end
@@ -0,0 +1,93 @@
+require 'minitest/autorun'
+require 'zemu'
+
+class DisassembleTest < Minitest::Test
+    BIN = File.join(__dir__, "..", "..", "bin")
+
+    def teardown
+        @instance.quit unless @instance.nil?
+    end
+
+    def test_disassemble
+        conf = Zemu::Config.new do
+            name "zemu_disassemble"
+
+            output_directory BIN
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+
+                contents [
+                    0x21, 0x00, 0x20,   # 0x0000: LD HL, #0x2000
+                    0xdd, 0x7e, 0x05,   # 0x0003: LD A, (IX+5)
+                    0x10, 0xfe,         # 0x0006: DJNZ #0x0006
+                    0xcd, 0x00, 0x01,   # 0x0008: CALL #0x0100
+                    0xed, 0xb0,         # 0x000b: LDIR
+                    0x76                # 0x000d: HALT
+                ]
+            end)
+        end
+
+        @instance = Zemu.start(conf)
+
+        instructions = @instance.disassemble(0x0000, 6)
+
+        assert_equal [0x0000, 0x0003, 0x0006, 0x0008, 0x000b, 0x000d], instructions.map(&:address)
+        assert_equal ["LD HL,$2000", "LD A,(IX+$05)", "DJNZ $0006", "CALL $0100", "LDIR", "HALT"], instructions.map(&:to_s)
+        assert_equal [10, 19, 8, 17, 16, 4], instructions.map(&:cycles)
+
+        djnz = instructions[2]
+        assert djnz.loop?
+        assert djnz.conditional?
+        assert_equal 13, djnz.cycles_taken
+        assert_equal 0x0006, djnz.target
+
+        assert instructions[3].call?
+        assert_equal 0x0100, instructions[3].target
+
+        assert instructions[4].repeat?
+        assert_equal 21, instructions[4].cycles_taken
+
+        assert instructions[5].halt?
+        assert_nil instructions[5].target
+    end
+
+    def test_invalidate_on_write
+        conf = Zemu::Config.new do
+            name "zemu_disassemble_invalidate"
+
+            output_directory BIN
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+
+                # Write a HALT instruction into RAM, and then halt.
+                contents [
+                    0x3e, 0x76,         # 0x0000: LD A, #0x76
+                    0x32, 0x00, 0x20,   # 0x0002: LD (#0x2000), A
+                    0x76                # 0x0005: HALT
+                ]
+            end)
+
+            add_memory (Zemu::Config::RAM.new do
+                name "ram"
+                address 0x2000
+                size 0x100
+            end)
+        end
+
+        @instance = Zemu.start(conf)
+
+        # The instruction in RAM is initially a NOP, and is cached.
+        assert_equal "NOP", @instance.disassemble(0x2000)[0].to_s
+
+        @instance.continue
+
+        # Having been overwritten, it is now a HALT.
+        assert_equal "HALT", @instance.disassemble(0x2000)[0].to_s
+    end
+end
@@ -0,0 +1,105 @@
+require 'minitest/autorun'
+require 'zemu'
+
+class FramebufferTest < Minitest::Test
+    BIN = File.join(__dir__, "..", "..", "bin")
+
+    def setup
+        conf = Zemu::Config.new do
+            name "zemu_framebuffer"
+
+            output_directory BIN
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+
+                contents [
+                    0x3e, 0x05,         # 0x0000: LD A, 0x05
+                    0xd3, 0x20,         # 0x0002: OUT (0x20), A
+                    0xaf,               # 0x0004: XOR A
+                    0xd3, 0x21,         # 0x0005: OUT (0x21), A
+                    0x3e, 0xe0,         # 0x0007: LD A, 0xe0
+                    0xd3, 0x22,         # 0x0009: OUT (0x22), A
+                    0xaf,               # 0x000b: XOR A
+                    0xd3, 0x30,         # 0x000c: OUT (0x30), A
+                    0xd3, 0x31,         # 0x000e: OUT (0x31), A
+                    0x3e, 0x48,         # 0x0010: LD A, 'H'
+                    0xd3, 0x32,         # 0x0012: OUT (0x32), A
+                    0x3e, 0x69,         # 0x0014: LD A, 'i'
+                    0xd3, 0x32,         # 0x0016: OUT (0x32), A
+                    0x76                # 0x0018: HALT
+                ]
+            end)
+
+            add_io (Zemu::Config::Framebuffer.new do
+                name "display"
+                width 16
+                height 8
+                address_low_port 0x20
+                address_high_port 0x21
+                data_port 0x22
+            end)
+
+            add_io (Zemu::Config::Framebuffer.new do
+                name "console"
+                mode :text
+                width 4
+                height 2
+                address_low_port 0x30
+                address_high_port 0x31
+                data_port 0x32
+            end)
+        end
+
+        @instance = Zemu.start(conf)
+    end
+
+    def teardown
+        @instance.quit unless @instance.nil?
+    end
+
+    def test_bitmap
+        before = @instance.frame("display")
+
+        assert_equal 16, before.width
+        assert_equal 8, before.height
+        assert_equal [0, 0, 0], before.pixel(5, 0)
+
+        # An unchanged framebuffer is not rendered again.
+        assert_same before, @instance.frame("display")
+
+        @instance.continue(1000)
+
+        after = @instance.frame("display")
+
+        refute_equal before, after
+        assert_equal [0xff, 0, 0], after.pixel(5, 0)
+        assert_equal [0, 0, 0], after.pixel(6, 0)
+    end
+
+    def test_text
+        @instance.continue(1000)
+
+        assert_equal "Hi  \n    ", @instance.frame("console")
+    end
+
+    def test_images
+        @instance.continue(1000)
+
+        frame = @instance.frame("display")
+
+        ppm = frame.to_ppm
+        assert ppm.start_with?("P6\n16 8\n255\n")
+        assert_equal "P6\n16 8\n255\n".bytesize + 16 * 8 * 3, ppm.bytesize
+
+        png = frame.to_png
+        assert png.start_with?("\x89PNG\r\n\x1a\n".b)
+        assert png.end_with?("IEND\xae\x42\x60\x82".b)
+    end
+
+    def test_unknown
+        assert_raises(ArgumentError) { @instance.frame("nonexistent") }
+    end
+end
@@ -0,0 +1,91 @@
+require 'minitest/autorun'
+require 'zemu'
+
+class FuzzTest < Minitest::Test
+    BIN = File.join(__dir__, "..", "..", "bin")
+
+    def setup
+        conf = Zemu::Config.new do
+            name "zemu_fuzz"
+
+            output_directory BIN
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+
+                # Halts if "FU" is read from the serial port.
+                contents [
+                    0xdb, 0x02,         # 0x0000: IN A, (0x02)
+                    0xa7,               # 0x0002: AND A
+                    0x28, 0xfb,         # 0x0003: JR Z, 0x0000
+                    0xdb, 0x00,         # 0x0005: IN A, (0x00)
+                    0xfe, 0x46,         # 0x0007: CP 'F'
+                    0x20, 0xf5,         # 0x0009: JR NZ, 0x0000
+                    0xdb, 0x02,         # 0x000b: IN A, (0x02)
+                    0xa7,               # 0x000d: AND A
+                    0x28, 0xfb,         # 0x000e: JR Z, 0x000b
+                    0xdb, 0x00,         # 0x0010: IN A, (0x00)
+                    0xfe, 0x55,         # 0x0012: CP 'U'
+                    0x20, 0xea,         # 0x0014: JR NZ, 0x0000
+                    0x76                # 0x0016: HALT
+                ]
+            end)
+
+            add_io (Zemu::Config::SerialPort.new do
+                name "serial"
+                in_port 0x00
+                out_port 0x01
+                ready_port 0x02
+            end)
+        end
+
+        @instance = Zemu.start(conf)
+        @instance.fuzz_setup("serial", cycles: 10_000)
+    end
+
+    def teardown
+        @instance.quit unless @instance.nil?
+    end
+
+    def test_input
+        @instance.fuzz("AB")
+        refute @instance.halted?
+
+        @instance.fuzz("FU")
+        assert @instance.halted?
+
+        # Each input starts from the snapshot.
+        @instance.fuzz("")
+        refute @instance.halted?
+    end
+
+    def test_coverage
+        none = @instance.fuzz("")
+        first = @instance.fuzz("F")
+
+        assert first > none
+
+        map = @instance.coverage
+        assert_equal Zemu::Instance::COVERAGE_MAP_SIZE, map.bytesize
+        assert_equal first, map.bytes.count { |b| b != 0 }
+
+        # Coverage is deterministic.
+        @instance.fuzz("F")
+        assert_equal map, @instance.coverage
+    end
+
+    def test_breakpoint
+        @instance.break(0x0016, :program)
+
+        @instance.fuzz("FU")
+        assert @instance.break?
+    end
+
+    def test_unknown_port
+        assert_raises ArgumentError do
+            @instance.fuzz_setup("nonexistent")
+        end
+    end
+end
@@ -0,0 +1,101 @@
+require 'minitest/autorun'
+require 'socket'
+require 'zemu'
+
+class GDBTest < Minitest::Test
+    BIN = File.join(__dir__, "..", "..", "bin")
+
+    def teardown
+        @instance.quit unless @instance.nil?
+    end
+
+    # Sends a packet and returns the reply, acknowledging packets as gdb does.
+    def request(socket, packet)
+        checksum = packet.bytes.sum & 0xff
+        socket.write("$#{packet}##{"%02x" % checksum}")
+
+        assert_equal "+", socket.read(1)
+
+        reply = socket.gets("#")
+        socket.read(2)
+        socket.write("+")
+
+        return reply[reply.index("$") + 1...-1]
+    end
+
+    def test_gdb
+        conf = Zemu::Config.new do
+            name "zemu_gdb"
+
+            output_directory BIN
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+
+                contents [
+                    0x3e, 0xa5,         # 0x0000: LD A, #0xa5
+                    0x32, 0x04, 0x20,   # 0x0002: LD (#0x2004), A
+                    0x00,               # 0x0005: NOP
+                    0x76,               # 0x0006: HALT
+                ]
+            end)
+
+            add_memory (Zemu::Config::RAM.new do
+                name "ram"
+                address 0x2000
+                size 0x100
+            end)
+        end
+
+        @instance = Zemu.start(conf)
+
+        path = File.join(BIN, "zemu_gdb.sock")
+
+        server = Thread.new { @instance.gdb_serve(path) }
+
+        socket = nil
+        100.times do
+            begin
+                socket = UNIXSocket.new(path)
+                break
+            rescue Errno::ENOENT, Errno::ECONNREFUSED
+                sleep 0.01
+            end
+        end
+
+        refute_nil socket
+
+        assert_equal "S05", request(socket, "?")
+
+        # PC is the sixth register, in little-endian byte order.
+        assert_equal "0000", request(socket, "p5")
+
+        # Stop after the write to RAM.
+        assert_equal "OK", request(socket, "Z2,2004,1")
+        assert_equal "T05watch:2004;", request(socket, "vCont;c")
+        assert_equal "0500", request(socket, "p5")
+        assert_equal "a5", request(socket, "m2004,1")
+
+        # Write memory, and stop at a breakpoint.
+        assert_equal "OK", request(socket, "M2000,2:1234")
+        assert_equal "1234", request(socket, "m2000,2")
+
+        # Short or malformed data writes nothing.
+        assert_equal "E01", request(socket, "M2000,2:56")
+        assert_equal "E01", request(socket, "M2000,2:56zz")
+        assert_equal "1234", request(socket, "m2000,2")
+        assert_equal "OK", request(socket, "Z0,6,1")
+        assert_equal "S05", request(socket, "c")
+        assert_equal "0600", request(socket, "p5")
+
+        assert_equal "OK", request(socket, "D")
+
+        assert_equal :detached, server.value
+        assert_equal 0x1234, (@instance.memory(0x2000) << 8) | @instance.memory(0x2001)
+        assert_equal 0x0006, @instance.registers["PC"]
+    ensure
+        socket.close unless socket.nil?
+    end
+end
@@ -0,0 +1,98 @@
+require 'minitest/autorun'
+require 'zemu'
+
+class HeatmapTest < Minitest::Test
+    BIN = File.join(__dir__, "..", "..", "bin")
+
+    def setup
+        conf = Zemu::Config.new do
+            name "zemu_heatmap"
+
+            output_directory BIN
+
+            heatmap true
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+
+                contents [
+                    0x3a, 0x00, 0x80,   # 0x0000: LD A, (0x8000)
+                    0x32, 0x00, 0x81,   # 0x0003: LD (0x8100), A
+                    0x32, 0x01, 0x81,   # 0x0006: LD (0x8101), A
+                    0x76                # 0x0009: HALT
+                ]
+            end)
+
+            add_memory (Zemu::Config::RAM.new do
+                name "ram"
+                address 0x8000
+                size 0x1000
+            end)
+        end
+
+        @instance = Zemu.start(conf)
+    end
+
+    def teardown
+        @instance.quit unless @instance.nil?
+    end
+
+    def test_pages
+        @instance.break(0x0009, :program)
+        @instance.continue
+
+        heatmap = @instance.heatmap
+
+        assert heatmap.page(0x0000)["fetches"] > 0
+        assert_equal 0, heatmap.page(0x0000)["writes"]
+
+        assert_equal 1, heatmap.page(0x8000)["reads"]
+        assert_equal 0, heatmap.page(0x8000)["writes"]
+        assert_equal 0, heatmap.page(0x8000)["fetches"]
+
+        assert_equal 2, heatmap.page(0x8100)["writes"]
+        assert_equal 0, heatmap.page(0x8100)["reads"]
+
+        assert_equal 0, heatmap.page(0x4000).values.sum
+    end
+
+    def test_blocks
+        @instance.break(0x0009, :program)
+        @instance.continue
+
+        blocks = @instance.heatmap.blocks
+
+        assert_equal ["rom", "ram"], blocks.keys
+        assert_equal 1, blocks["ram"]["reads"]
+        assert_equal 2, blocks["ram"]["writes"]
+        assert blocks["rom"]["fetches"] > 0
+    end
+
+    def test_output
+        @instance.break(0x0009, :program)
+        @instance.continue
+
+        heatmap = @instance.heatmap
+
+        hash = JSON.parse(heatmap.to_json)
+        assert_equal 2, hash["pages"]["0x8100"]["writes"]
+        refute hash["pages"].key?("0x4000")
+
+        lines = heatmap.to_s.lines
+        assert_equal 17 + 2, lines.size
+        assert lines[9].start_with?("0x8000 ")
+    end
+
+    def test_clear
+        @instance.break(0x0009, :program)
+        @instance.continue
+
+        @instance.clear_heatmap
+        heatmap = @instance.heatmap
+
+        assert_equal 0, heatmap.page(0x8000)["reads"]
+        assert_equal 0, heatmap.page(0x8100)["writes"]
+    end
+end
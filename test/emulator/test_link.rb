@@ -0,0 +1,91 @@
+require 'minitest/autorun'
+require 'zemu'
+
+class LinkTest < Minitest::Test
+    BIN = File.join(__dir__, "..", "..", "bin")
+
+    def make_config(config_name, program)
+        Zemu::Config.new do
+            name config_name
+
+            output_directory BIN
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+
+                contents program
+            end)
+
+            add_memory (Zemu::Config::RAM.new do
+                name "ram"
+                address 0x8000
+                size 0x1000
+            end)
+
+            add_io (Zemu::Config::SerialPort.new do
+                name "serial"
+                in_port 0x00
+                out_port 0x01
+                ready_port 0x02
+            end)
+        end
+    end
+
+    def setup
+        # Sends a byte, and stores the reply.
+        @sender = Zemu.start(make_config("zemu_link_sender", [
+            0x3e, 0x41,         # 0x0000: LD A, 0x41
+            0xd3, 0x01,         # 0x0002: OUT (0x01), A
+            0xdb, 0x02,         # 0x0004: IN A, (0x02)
+            0xb7,               # 0x0006: OR A
+            0x28, 0xfb,         # 0x0007: JR Z, 0x0004
+            0xdb, 0x00,         # 0x0009: IN A, (0x00)
+            0x32, 0x00, 0x80,   # 0x000b: LD (0x8000), A
+            0x76                # 0x000e: HALT
+        ]))
+
+        # Echoes a byte.
+        @echo = Zemu.start(make_config("zemu_link_echo", [
+            0xdb, 0x02,         # 0x0000: IN A, (0x02)
+            0xb7,               # 0x0002: OR A
+            0x28, 0xfb,         # 0x0003: JR Z, 0x0000
+            0xdb, 0x00,         # 0x0005: IN A, (0x00)
+            0xd3, 0x01,         # 0x0007: OUT (0x01), A
+            0x76                # 0x0009: HALT
+        ]))
+    end
+
+    def teardown
+        @sender.quit unless @sender.nil?
+        @echo.quit unless @echo.nil?
+    end
+
+    # Linked instances exchange bytes natively, with deterministic timing.
+    def test_echo
+        @sender.link_serial("serial", @echo, "serial", latency: 500)
+
+        @echo.start_async(1_000_000)
+        @sender.start_async(1_000_000)
+
+        assert @sender.wait(5)
+        assert @echo.wait(5)
+
+        assert @sender.halted?
+        assert @echo.halted?
+        assert_equal 0x41, @sender.memory(0x8000)
+
+        # The reply arrives two latencies after the byte was sent.
+        assert @sender.cycles > 1000
+        assert @sender.cycles < 1500
+
+        # Linked serial ports do not send to the host.
+        assert_equal "", @sender.serial_gets
+    end
+
+    def test_invalid_link
+        assert_raises(ArgumentError) { @sender.link_serial("serial", @echo, "serial", latency: 0) }
+        assert_raises(ArgumentError) { @sender.link_serial("nonexistent", @echo, "serial") }
+    end
+end
@@ -0,0 +1,98 @@
+require 'minitest/autorun'
+require 'zemu'
+
+class MultiCPUTest < Minitest::Test
+    BIN = File.join(__dir__, "..", "..", "bin")
+
+    def setup
+        conf = Zemu::Config.new do
+            name "zemu_multi_cpu"
+
+            output_directory BIN
+
+            clock_speed 4_000_000
+
+            add_cpu (Zemu::Config::CPU.new do
+                name "main"
+            end)
+
+            add_cpu (Zemu::Config::CPU.new do
+                name "sound"
+                clock_speed 2_000_000
+            end)
+
+            # Program of the primary CPU: waits for a byte in the mailbox and stores it.
+            add_memory (Zemu::Config::ROM.new do
+                name "rom_main"
+                address 0x0000
+                size 0x1000
+                cpus ["main"]
+
+                contents [
+                    0xdb, 0x11,         # 0x0000: IN A, (0x11)
+                    0xe6, 0x01,         # 0x0002: AND 1
+                    0x28, 0xfa,         # 0x0004: JR Z, 0x0000
+                    0xdb, 0x10,         # 0x0006: IN A, (0x10)
+                    0x32, 0x00, 0x80,   # 0x0008: LD (0x8000), A
+                    0x76                # 0x000b: HALT
+                ]
+            end)
+
+            # Program of the secondary CPU: sends a byte to the mailbox and to shared memory.
+            add_memory (Zemu::Config::ROM.new do
+                name "rom_sound"
+                address 0x0000
+                size 0x1000
+                cpus ["sound"]
+
+                contents [
+                    0x3e, 0x5a,         # 0x0000: LD A, 0x5a
+                    0xd3, 0x10,         # 0x0002: OUT (0x10), A
+                    0x32, 0x01, 0x80,   # 0x0004: LD (0x8001), A
+                    0x76                # 0x0007: HALT
+                ]
+            end)
+
+            add_memory (Zemu::Config::RAM.new do
+                name "ram"
+                address 0x8000
+                size 0x1000
+            end)
+
+            add_io (Zemu::Config::Mailbox.new do
+                name "mailbox"
+                cpus ["main", "sound"]
+                data_port 0x10
+                status_port 0x11
+            end)
+        end
+
+        @instance = Zemu.start(conf)
+    end
+
+    def teardown
+        @instance.quit unless @instance.nil?
+    end
+
+    # CPUs see their own memory blocks, and share unrestricted ones.
+    def test_memory
+        assert_equal ["main", "sound"], @instance.cpus
+        assert_equal 0xdb, @instance.memory(0x0000)
+        assert_equal 0x3e, @instance.memory(0x0000, "sound")
+        assert_equal 0x3e, @instance.memory(0x0000, 1)
+
+        assert_raises ArgumentError do
+            @instance.memory(0x0000, "video")
+        end
+    end
+
+    # The CPUs run in lockstep, and communicate through the mailbox and shared memory.
+    def test_mailbox
+        @instance.continue(100_000)
+
+        assert @instance.halted?
+        assert_equal 0x5a, @instance.memory(0x8000)
+        assert_equal 0x5a, @instance.memory(0x8001)
+        assert_equal 0x5a, @instance.registers("sound")["A"]
+    end
+end
@@ -0,0 +1,169 @@
+require 'minitest/autorun'
+require 'zemu'
+
+class PoolTest < Minitest::Test
+    BIN = File.join(__dir__, "..", "..", "bin")
+
+    def setup
+        @conf = Zemu::Config.new do
+            name "zemu_pool"
+
+            output_directory BIN
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+
+                contents [
+                    0x3a, 0x00, 0x80,   # 0x0000: LD A, (0x8000)
+                    0x3c,               # 0x0003: INC A
+                    0x32, 0x00, 0x80,   # 0x0004: LD (0x8000), A
+                    0x76                # 0x0007: HALT
+                ]
+            end)
+
+            add_memory (Zemu::Config::RAM.new do
+                name "ram"
+                address 0x8000
+                size 0x100
+            end)
+        end
+
+        @pool = Zemu::Pool.new(@conf, size: 2)
+    end
+
+    def teardown
+        @pool.shutdown unless @pool.nil?
+    end
+
+    def test_reset_between_uses
+        3.times do
+            @pool.with do |instance|
+                instance.continue
+                assert instance.halted?
+                assert_equal 1, instance.memory(0x8000)
+            end
+        end
+    end
+
+    def test_separate_state
+        a = @pool.checkout
+        b = @pool.checkout
+
+        a.continue
+        b.continue
+
+        # Instances sharing memory would leave 2 at 0x8000.
+        assert_equal 1, a.memory(0x8000)
+        assert_equal 1, b.memory(0x8000)
+        assert b.halted?
+
+        @pool.release(a)
+        @pool.release(b)
+    end
+
+    def test_snapshot
+        snapshot = @pool.with do |instance|
+            instance.break(0x0004, :program)
+            instance.continue
+            instance.set_register("A", 0x41)
+            instance.snapshot
+        end
+
+        @pool.with(snapshot) do |instance|
+            instance.continue
+            assert_equal 0x42, instance.memory(0x8000)
+        end
+    end
+
+    def test_breakpoints_cleared
+        @pool.with do |instance|
+            instance.break(0x0004, :program)
+            instance.continue
+            assert instance.break?
+        end
+
+        @pool.with do |instance|
+            instance.continue
+            assert instance.halted?
+        end
+    end
+
+    def test_wait_for_release
+        a = @pool.checkout
+        b = @pool.checkout
+
+        waiter = Thread.new { @pool.checkout }
+
+        sleep 0.1
+        assert waiter.alive?
+
+        @pool.release(a)
+        c = waiter.value
+
+        assert_same a, c
+
+        @pool.release(b)
+        @pool.release(c)
+    end
+
+    def test_serial_cleared
+        conf = Zemu::Config.new do
+            name "zemu_pool_serial"
+
+            output_directory BIN
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+
+                contents [
+                    0x3e, 0x58,         # 0x0000: LD A, 'X'
+                    0xd3, 0x01,         # 0x0002: OUT (0x01), A
+                    0x76                # 0x0004: HALT
+                ]
+            end)
+
+            add_io (Zemu::Config::SerialPort.new do
+                name "serial"
+                in_port 0x00
+                out_port 0x01
+                ready_port 0x02
+            end)
+        end
+
+        pool = Zemu::Pool.new(conf, size: 1)
+
+        # The first user leaves its output, and some input, unread.
+        pool.with do |instance|
+            instance.continue
+            instance.serial_puts("abc")
+        end
+
+        pool.with do |instance|
+            instance.continue
+            assert_equal "X", instance.serial_gets
+        end
+    ensure
+        pool.shutdown unless pool.nil?
+    end
+
+    def test_shutdown
+        instance = @pool.checkout
+        @pool.shutdown
+
+        assert_raises(RuntimeError) { @pool.checkout }
+
+        # Released after shutdown, the instance is quit rather than kept.
+        @pool.release(instance)
+        assert_raises(RuntimeError) { @pool.checkout }
+    end
+
+    def test_max_memory
+        pool = Zemu::Pool.new(@conf, size: 8, max_memory: 1)
+        assert_equal 1, pool.size
+        pool.shutdown
+    end
+end
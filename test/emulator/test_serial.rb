@@ -161,4 +161,48 @@ class SerialTest < Minitest::Test
         assert_equal "H", @instance.serial_gets(1)
         assert_equal "ello", @instance.serial_gets()
     end
+
+    def test_run_until_output
+        conf = Zemu::Config.new do
+            name "zemu_run_until_output"
+
+            output_directory BIN
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+
+                contents [
+                    0x21, 0x20, 0x00,   # 0x0000: LD HL, #0x0020
+                    0x06, 0x0c,         # 0x0003: LD B, #0x0c
+                    0x7e,               # 0x0005: LD A, (HL)
+                    0xd3, 0x01,         # 0x0006: OUT (#0x01), A
+                    0x23,               # 0x0008: INC HL
+                    0x10, 0xfa,         # 0x0009: DJNZ #0x0005 (-6)
+                    0x76                # 0x000b: HALT
+                ] + [0x00] * 0x14 + "READ READY>!".bytes
+            end)
+
+            add_io (Zemu::Config::SerialPort.new do
+                name "serial"
+                in_port 0x00
+                out_port 0x01
+                ready_port 0x02
+            end)
+        end
+
+        @instance = Zemu.start(conf)
+
+        # Stop immediately after the pattern is output.
+        assert @instance.run_until_output("READY>", timeout_cycles: 100_000)
+        assert_equal 0x0008, @instance.registers["PC"]
+        assert_equal "READ READY>", @instance.serial_gets
+
+        # Return false if the pattern does not appear.
+        refute @instance.run_until_output("READY>", timeout_cycles: 1000)
+        assert_equal "!", @instance.serial_gets
+
+        assert_raises(ArgumentError) { @instance.run_until_output("") }
+    end
 end
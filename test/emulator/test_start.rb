@@ -109,6 +109,45 @@ class StartTest < Minitest::Test
         assert @instance.halted?
     end
 
+    def test_conditional_break
+        conf = Zemu::Config.new do
+            name "zemu_conditional_break"
+
+            output_directory BIN
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+
+                contents [
+                    0x06, 0x0a,         # 0x0000: LD B, #10
+                    0x05,               # 0x0002: DEC B
+                    0x20, 0xfd,         # 0x0003: JR NZ, 0x0002
+                    0x76,               # 0x0005: HALT
+                ]
+            end)
+        end
+
+        @instance = Zemu.start(conf)
+
+        @instance.break 0x0002, :program, condition: "B == 3"
+
+        @instance.continue
+
+        # Only stop when the condition is true.
+        assert @instance.break?
+        assert_equal 0x0002, @instance.registers["PC"]
+        assert_equal 3, @instance.registers["B"]
+        assert_equal 8, @instance.hits(0x0002)
+
+        @instance.continue
+
+        assert @instance.halted?
+
+        assert_raises(ArgumentError) { @instance.break 0x0002, :program, condition: "B ==" }
+    end
+
     def test_memory_write
         conf = Zemu::Config.new do
             name "zemu_memory_write"
@@ -161,6 +200,59 @@ class StartTest < Minitest::Test
         assert_equal 0xa5, @instance.registers["B"]
     end
 
+    def test_memory_break
+        conf = Zemu::Config.new do
+            name "zemu_memory_break"
+
+            output_directory BIN
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+                
+                # Write a value to RAM, read it, and then halt.
+                contents [
+                    0x21, 0x04, 0x20,   # 0x0000: LD HL, #0x2004
+                    0x3e, 0xa5,         # 0x0003: LD A, #0xa5
+                    0x77,               # 0x0005: LD (HL), A
+                    0x46,               # 0x0006: LD B, (HL)
+                    0x76,               # 0x0007: HALT
+                ]
+            end)
+
+            add_memory (Zemu::Config::RAM.new do
+                name "ram"
+                address 0x2000
+                size 0x100
+            end)
+        end
+
+        @instance = Zemu.start(conf)
+
+        @instance.break 0x2004, :write
+        @instance.break 0x2004, :read
+
+        # Break after the LD (HL), A
+        @instance.continue
+
+        assert @instance.break?
+        assert_equal 0x0006, @instance.registers["PC"]
+        assert_equal 0xa5, @instance.memory(0x2004)
+
+        # Break after the LD B, (HL)
+        @instance.continue
+
+        assert @instance.break?
+        assert_equal 0x0007, @instance.registers["PC"]
+
+        @instance.remove_break 0x2004, :access
+
+        @instance.continue
+
+        assert @instance.halted?
+    end
+
     def test_clock_speed
         conf = Zemu::Config.new do
             name "zemu_clock_speed"
@@ -174,4 +266,44 @@ class StartTest < Minitest::Test
 
         assert_equal 8_000_000, @instance.clock_speed
     end
+
+    def test_wrapper_cached
+        conf = Zemu::Config.new do
+            name "zemu_wrapper_cached"
+
+            output_directory BIN
+        end
+
+        @instance = Zemu.start(conf)
+
+        # The library is only loaded once, however many instances are created.
+        wrapper = Zemu::Instance.wrapper(conf, conf.library)
+        assert_same wrapper, Zemu::Instance.wrapper(conf, conf.library)
+
+        # Rebuilding the library with a changed configuration loads the rebuilt code.
+        changed = Zemu::Config.new do
+            name "zemu_wrapper_cached"
+
+            output_directory BIN
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+                contents [0x42]
+            end)
+        end
+
+        assert Zemu.build(changed)
+        refute_same wrapper, Zemu::Instance.wrapper(changed, changed.library)
+
+        rebuilt = Zemu::Instance.new(changed)
+
+        begin
+            assert_equal 0x42, rebuilt.memory(0x0000)
+            assert_equal 0x00, @instance.memory(0x0000)
+        ensure
+            rebuilt.quit
+        end
+    end
 end
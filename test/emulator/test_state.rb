@@ -0,0 +1,77 @@
+require 'minitest/autorun'
+require 'zemu'
+
+class StateTest < Minitest::Test
+    BIN = File.join(__dir__, "..", "..", "bin")
+
+    def setup
+        conf = Zemu::Config.new do
+            name "zemu_state"
+
+            output_directory BIN
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+
+                contents [
+                    0x76,               # 0x0000: HALT
+                    0x3c,               # 0x0001: INC A
+                    0x76,               # 0x0002: HALT
+                ]
+            end)
+        end
+
+        @instance = Zemu.start(conf)
+    end
+
+    def teardown
+        @instance.quit unless @instance.nil?
+    end
+
+    def test_set_register
+        @instance.set_register("HL", 0x1234)
+        @instance.set_register("A'", 0x56)
+        @instance.set_register("IM", 2)
+
+        assert_equal 0x12, @instance.registers["H"]
+        assert_equal 0x34, @instance.registers["L"]
+        assert_equal 0x56, @instance.registers["A'"]
+        assert_equal 2, @instance.registers["IM"]
+
+        assert_raises(ArgumentError) { @instance.set_register("Q", 0) }
+    end
+
+    def test_cpu_state
+        @instance.cpu_state = { "SP" => 0x2000, "BC'" => 0xbeef, "I" => 0x80, "IFF1" => 1, "IFF2" => 1 }
+
+        state = @instance.cpu_state
+
+        assert_equal 0x2000, state["SP"]
+        assert_equal 0xbeef, state["BC'"]
+        assert_equal 0x80, state["I"]
+        assert_equal 1, state["IFF1"]
+        assert_equal 1, state["IFF2"]
+        refute state["halted"]
+
+        # Restoring a state restores every register.
+        @instance.cpu_state = { "SP" => 0, "BC'" => 0 }
+        @instance.cpu_state = state
+        assert_equal state, @instance.cpu_state
+    end
+
+    def test_clear_halt
+        @instance.continue
+        assert @instance.halted?
+        assert @instance.cpu_state["halted"]
+
+        # Patch PC and continue past the HALT.
+        @instance.cpu_state = { "PC" => 0x0001, "AF" => 0x4100, "halted" => false }
+        refute @instance.halted?
+
+        @instance.continue
+        assert @instance.halted?
+        assert_equal 0x42, @instance.registers["A"]
+    end
+end
@@ -0,0 +1,90 @@
+require 'minitest/autorun'
+require 'zemu'
+
+class StepTest < Minitest::Test
+    BIN = File.join(__dir__, "..", "..", "bin")
+
+    def setup
+        conf = Zemu::Config.new do
+            name "zemu_step"
+
+            output_directory BIN
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+
+                contents [
+                    0x31, 0x00, 0x21,   # 0x0000: LD SP, #0x2100
+                    0xcd, 0x10, 0x00,   # 0x0003: CALL 0x0010
+                    0x06, 0x03,         # 0x0006: LD B, #3
+                    0x10, 0xfe,         # 0x0008: DJNZ 0x0008
+                    0x76,               # 0x000a: HALT
+                    0x00, 0x00, 0x00, 0x00, 0x00,
+                    0x00,               # 0x0010: NOP
+                    0x00,               # 0x0011: NOP
+                    0xc9,               # 0x0012: RET
+                ]
+            end)
+
+            add_memory (Zemu::Config::RAM.new do
+                name "ram"
+                address 0x2000
+                size 0x100
+            end)
+        end
+
+        @instance = Zemu.start(conf)
+    end
+
+    def teardown
+        @instance.quit unless @instance.nil?
+    end
+
+    def test_step_over
+        @instance.run_to 0x0003
+
+        assert @instance.reached?
+        assert_equal 0x0003, @instance.registers["PC"]
+
+        # Step over the CALL.
+        @instance.step_over
+        assert @instance.reached?
+        assert_equal 0x0006, @instance.registers["PC"]
+
+        # Step over the LD.
+        @instance.step_over
+        assert_equal 0x0008, @instance.registers["PC"]
+
+        # Step over the whole DJNZ loop.
+        @instance.step_over
+        assert @instance.reached?
+        assert_equal 0x000a, @instance.registers["PC"]
+        assert_equal 0, @instance.registers["B"]
+    end
+
+    def test_step_out
+        symbols = Zemu::Debug::SymbolTable.new([Zemu::Debug::Symbol.new("sub", 0x0010)])
+
+        @instance.run_to "sub", symbols: symbols
+        assert_equal 0x0010, @instance.registers["PC"]
+
+        @instance.step_out
+        assert @instance.reached?
+        assert_equal 0x0006, @instance.registers["PC"]
+        assert_equal 0x2100, @instance.registers["SP"]
+
+        assert_raises(ArgumentError) { @instance.run_to "missing", symbols: symbols }
+    end
+
+    def test_breakpoint_stops_step_over
+        @instance.break 0x0011, :program
+
+        @instance.run_to 0x0003
+        @instance.step_over
+
+        assert @instance.break?
+        assert_equal 0x0011, @instance.registers["PC"]
+    end
+end
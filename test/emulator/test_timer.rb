@@ -131,4 +131,66 @@ eos
         # We'd expect to be in the ISR.
         assert @instance.halted?, "Expected to hit HALT."
     end
+
+    def test_batched_timing
+        program = [
+            0x31, 0x00, 0x90,       # 0x0000: LD SP, 0x9000
+            0x3e, 0x64,             # 0x0003: LD A, 100
+            0xd3, 0x00,             # 0x0005: OUT (0x00), A
+            0x3e, 0x01,             # 0x0007: LD A, 1
+            0xd3, 0x01,             # 0x0009: OUT (0x01), A
+            0x06, 0x00,             # 0x000b: LD B, 0
+            0x04,                   # 0x000d: INC B
+            0x00, 0x00, 0x00, 0x00, # 0x000e: NOP x 8
+            0x00, 0x00, 0x00, 0x00,
+            0x18, 0xf5              # 0x0016: JR 0x000d
+        ]
+
+        # The NMI handler halts, so the return address shows where the NMI was accepted.
+        program += [0x00] * (0x66 - program.size) + [0x76]
+
+        results = [false, true].map do |batched|
+            conf = Zemu::Config.new do
+                name batched ? "zemu_timer_batched" : "zemu_timer_stepped"
+
+                output_directory BIN
+
+                batch_blocks batched
+
+                add_memory (Zemu::Config::ROM.new do
+                    name "rom"
+                    address 0x0000
+                    size 0x1000
+
+                    contents program
+                end)
+
+                add_memory (Zemu::Config::RAM.new do
+                    name "ram"
+                    address 0x8000
+                    size 0x1000
+                end)
+
+                add_io (Zemu::Config::Timer.new do
+                    name "timer_nmi"
+                    count_port 0x00
+                    control_port 0x01
+                end)
+            end
+
+            instance = Zemu.start(conf)
+
+            begin
+                cycles = instance.continue(10_000)
+                assert instance.halted?, "Expected to halt in the ISR."
+
+                [cycles, instance.registers["B"], instance.memory(0x8ffe) | (instance.memory(0x8fff) << 8)]
+            ensure
+                instance.quit
+            end
+        end
+
+        # Blocks never run across a timer interrupt, so it is accepted at the same instruction.
+        assert_equal results[0], results[1]
+    end
 end
@@ -0,0 +1,74 @@
+require 'minitest/autorun'
+require 'zemu'
+
+class WatchdogTest < Minitest::Test
+    BIN = File.join(__dir__, "..", "..", "bin")
+
+    def setup
+        conf = Zemu::Config.new do
+            name "zemu_watchdog"
+
+            output_directory BIN
+
+            add_memory (Zemu::Config::ROM.new do
+                name "rom"
+                address 0x0000
+                size 0x1000
+
+                contents [
+                    0x00,               # 0x0000: NOP
+                    0x18, 0xfd          # 0x0001: JR 0x0000
+                ]
+            end)
+        end
+
+        @instance = Zemu.start(conf)
+    end
+
+    def teardown
+        @instance.quit unless @instance.nil?
+    end
+
+    def test_cycles
+        @instance.watchdog(cycles: 10_000)
+
+        cycles = @instance.continue
+
+        assert @instance.timed_out?
+        assert cycles >= 10_000
+        assert cycles < 12_000
+        assert_includes [0x0000, 0x0001], @instance.stop_pc
+    end
+
+    def test_instructions
+        @instance.watchdog(instructions: 1_000)
+
+        cycles = @instance.continue
+
+        assert @instance.timed_out?
+
+        # Each instruction takes 4 (NOP) or 12 (JR) cycles.
+        assert cycles >= 8 * 1_000
+    end
+
+    def test_seconds
+        @instance.watchdog(seconds: 0.05)
+
+        start = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+        @instance.continue
+        elapsed = Process.clock_gettime(Process::CLOCK_MONOTONIC) - start
+
+        assert @instance.timed_out?
+        assert elapsed < 5
+    end
+
+    # Without limits, the number of cycles given to a run is not a timeout.
+    def test_no_limit
+        @instance.watchdog(cycles: 10_000)
+        @instance.watchdog
+
+        @instance.continue(20_000)
+
+        refute @instance.timed_out?
+    end
+end